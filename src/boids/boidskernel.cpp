@@ -0,0 +1,253 @@
+#include "boidskernel.h"
+
+#include <assert.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BOIDS_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BOIDS_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define BOIDS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define BOIDS_KERNEL_X86 0
+#endif
+
+namespace {
+#if BOIDS_KERNEL_X86
+	void cpuid(int leaf, int subLeaf, int registers[4]) {
+#if defined(_MSC_VER)
+		__cpuidex(registers, leaf, subLeaf);
+#else
+		unsigned int a, b, c, d;
+		__cpuid_count(leaf, subLeaf, a, b, c, d);
+		registers[0] = int(a);
+		registers[1] = int(b);
+		registers[2] = int(c);
+		registers[3] = int(d);
+#endif
+	}
+
+	unsigned long long readXcr0() {
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (unsigned long long)edx << 32 | eax;
+#endif
+	}
+
+	eSimdLevel querySimdLevel() {
+		int registers[4];
+		cpuid(0, 0, registers);
+		const int maxLeaf = registers[0];
+
+		cpuid(1, 0, registers);
+		const bool sse2 = (registers[3] & (1 << 26)) != 0;
+		const bool osxsave = (registers[2] & (1 << 27)) != 0;
+		const bool avx = (registers[2] & (1 << 28)) != 0;
+		if (!sse2) {
+			return eSimdLevel::Scalar;
+		}
+
+		// the OS must save the ymm registers on context switches
+		const bool osSavesYmm = osxsave && avx && (readXcr0() & 0x6) == 0x6;
+		if (osSavesYmm && maxLeaf >= 7) {
+			cpuid(7, 0, registers);
+			if (registers[1] & (1 << 5)) {
+				return eSimdLevel::AVX2;
+			}
+		}
+		return eSimdLevel::SSE2;
+	}
+
+	float horizontalSum(__m128 v) {
+		__m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(v, shuffled);
+		shuffled = _mm_movehl_ps(shuffled, sums);
+		sums = _mm_add_ss(sums, shuffled);
+		return _mm_cvtss_f32(sums);
+	}
+
+	// returns the index of the first neighbor left to the scalar loop
+	size_t accumulateSSE2(const BoidNeighborBatch& batch, const glm::vec3& position, float visualRangeSqr, float minDistanceSqr, BoidNeighborSums& sums) {
+		const __m128 px = _mm_set1_ps(position.x);
+		const __m128 py = _mm_set1_ps(position.y);
+		const __m128 pz = _mm_set1_ps(position.z);
+		const __m128 visualRange = _mm_set1_ps(visualRangeSqr);
+		const __m128 minDistance = _mm_set1_ps(minDistanceSqr);
+		const __m128 one = _mm_set1_ps(1.f);
+
+		__m128 centerX = _mm_setzero_ps(), centerY = _mm_setzero_ps(), centerZ = _mm_setzero_ps();
+		__m128 velocityX = _mm_setzero_ps(), velocityY = _mm_setzero_ps(), velocityZ = _mm_setzero_ps();
+		__m128 moveX = _mm_setzero_ps(), moveY = _mm_setzero_ps(), moveZ = _mm_setzero_ps();
+		__m128 count = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= batch.count; i += 4) {
+			const __m128 nx = _mm_loadu_ps(&batch.positionX[i]);
+			const __m128 ny = _mm_loadu_ps(&batch.positionY[i]);
+			const __m128 nz = _mm_loadu_ps(&batch.positionZ[i]);
+			const __m128 dx = _mm_sub_ps(px, nx);
+			const __m128 dy = _mm_sub_ps(py, ny);
+			const __m128 dz = _mm_sub_ps(pz, nz);
+			const __m128 distanceSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			const __m128 inVisualRange = _mm_cmplt_ps(distanceSqr, visualRange);
+			const __m128 tooClose = _mm_cmplt_ps(distanceSqr, minDistance);
+
+			centerX = _mm_add_ps(centerX, _mm_and_ps(inVisualRange, nx));
+			centerY = _mm_add_ps(centerY, _mm_and_ps(inVisualRange, ny));
+			centerZ = _mm_add_ps(centerZ, _mm_and_ps(inVisualRange, nz));
+			velocityX = _mm_add_ps(velocityX, _mm_and_ps(inVisualRange, _mm_loadu_ps(&batch.velocityX[i])));
+			velocityY = _mm_add_ps(velocityY, _mm_and_ps(inVisualRange, _mm_loadu_ps(&batch.velocityY[i])));
+			velocityZ = _mm_add_ps(velocityZ, _mm_and_ps(inVisualRange, _mm_loadu_ps(&batch.velocityZ[i])));
+			count = _mm_add_ps(count, _mm_and_ps(inVisualRange, one));
+			moveX = _mm_add_ps(moveX, _mm_and_ps(tooClose, dx));
+			moveY = _mm_add_ps(moveY, _mm_and_ps(tooClose, dy));
+			moveZ = _mm_add_ps(moveZ, _mm_and_ps(tooClose, dz));
+		}
+
+		sums.center += glm::vec3(horizontalSum(centerX), horizontalSum(centerY), horizontalSum(centerZ));
+		sums.velocity += glm::vec3(horizontalSum(velocityX), horizontalSum(velocityY), horizontalSum(velocityZ));
+		sums.move += glm::vec3(horizontalSum(moveX), horizontalSum(moveY), horizontalSum(moveZ));
+		sums.numNeighbors += int(horizontalSum(count));
+		return i;
+	}
+
+	BOIDS_TARGET_AVX2 float horizontalSum(__m256 v) {
+		return horizontalSum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+	}
+
+	BOIDS_TARGET_AVX2 size_t accumulateAVX2(const BoidNeighborBatch& batch, const glm::vec3& position, float visualRangeSqr, float minDistanceSqr, BoidNeighborSums& sums) {
+		const __m256 px = _mm256_set1_ps(position.x);
+		const __m256 py = _mm256_set1_ps(position.y);
+		const __m256 pz = _mm256_set1_ps(position.z);
+		const __m256 visualRange = _mm256_set1_ps(visualRangeSqr);
+		const __m256 minDistance = _mm256_set1_ps(minDistanceSqr);
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		__m256 centerX = _mm256_setzero_ps(), centerY = _mm256_setzero_ps(), centerZ = _mm256_setzero_ps();
+		__m256 velocityX = _mm256_setzero_ps(), velocityY = _mm256_setzero_ps(), velocityZ = _mm256_setzero_ps();
+		__m256 moveX = _mm256_setzero_ps(), moveY = _mm256_setzero_ps(), moveZ = _mm256_setzero_ps();
+		__m256 count = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= batch.count; i += 8) {
+			const __m256 nx = _mm256_loadu_ps(&batch.positionX[i]);
+			const __m256 ny = _mm256_loadu_ps(&batch.positionY[i]);
+			const __m256 nz = _mm256_loadu_ps(&batch.positionZ[i]);
+			const __m256 dx = _mm256_sub_ps(px, nx);
+			const __m256 dy = _mm256_sub_ps(py, ny);
+			const __m256 dz = _mm256_sub_ps(pz, nz);
+			const __m256 distanceSqr = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+			const __m256 inVisualRange = _mm256_cmp_ps(distanceSqr, visualRange, _CMP_LT_OQ);
+			const __m256 tooClose = _mm256_cmp_ps(distanceSqr, minDistance, _CMP_LT_OQ);
+
+			centerX = _mm256_add_ps(centerX, _mm256_and_ps(inVisualRange, nx));
+			centerY = _mm256_add_ps(centerY, _mm256_and_ps(inVisualRange, ny));
+			centerZ = _mm256_add_ps(centerZ, _mm256_and_ps(inVisualRange, nz));
+			velocityX = _mm256_add_ps(velocityX, _mm256_and_ps(inVisualRange, _mm256_loadu_ps(&batch.velocityX[i])));
+			velocityY = _mm256_add_ps(velocityY, _mm256_and_ps(inVisualRange, _mm256_loadu_ps(&batch.velocityY[i])));
+			velocityZ = _mm256_add_ps(velocityZ, _mm256_and_ps(inVisualRange, _mm256_loadu_ps(&batch.velocityZ[i])));
+			count = _mm256_add_ps(count, _mm256_and_ps(inVisualRange, one));
+			moveX = _mm256_add_ps(moveX, _mm256_and_ps(tooClose, dx));
+			moveY = _mm256_add_ps(moveY, _mm256_and_ps(tooClose, dy));
+			moveZ = _mm256_add_ps(moveZ, _mm256_and_ps(tooClose, dz));
+		}
+
+		sums.center += glm::vec3(horizontalSum(centerX), horizontalSum(centerY), horizontalSum(centerZ));
+		sums.velocity += glm::vec3(horizontalSum(velocityX), horizontalSum(velocityY), horizontalSum(velocityZ));
+		sums.move += glm::vec3(horizontalSum(moveX), horizontalSum(moveY), horizontalSum(moveZ));
+		sums.numNeighbors += int(horizontalSum(count));
+		return i;
+	}
+#endif
+}
+
+eSimdLevel detectSimdLevel() {
+#if BOIDS_KERNEL_X86
+	static const eSimdLevel level = querySimdLevel();
+	return level;
+#else
+	return eSimdLevel::Scalar;
+#endif
+}
+
+char const* simdLevelName(eSimdLevel level) {
+	switch (level) {
+	case eSimdLevel::SSE2:
+		return "SSE2";
+	case eSimdLevel::AVX2:
+		return "AVX2";
+	default:
+		return "Scalar";
+	}
+}
+
+void gatherBoidNeighborBatch(BoidNeighborBatch& batch, const BoidSwarm& boids, size_t boid, const std::vector<int>& candidates) {
+	if (batch.positionX.size() < candidates.size()) {
+		batch.positionX.resize(candidates.size());
+		batch.positionY.resize(candidates.size());
+		batch.positionZ.resize(candidates.size());
+		batch.velocityX.resize(candidates.size());
+		batch.velocityY.resize(candidates.size());
+		batch.velocityZ.resize(candidates.size());
+	}
+
+	const float* positionX = boids.positionX();
+	const float* positionY = boids.positionY();
+	const float* positionZ = boids.positionZ();
+	const float* velocityX = boids.velocityX();
+	const float* velocityY = boids.velocityY();
+	const float* velocityZ = boids.velocityZ();
+
+	size_t count = 0;
+	for (int i : candidates) {
+		if (size_t(i) == boid) {
+			continue;
+		}
+		batch.positionX[count] = positionX[i];
+		batch.positionY[count] = positionY[i];
+		batch.positionZ[count] = positionZ[i];
+		batch.velocityX[count] = velocityX[i];
+		batch.velocityY[count] = velocityY[i];
+		batch.velocityZ[count] = velocityZ[i];
+		count++;
+	}
+	batch.count = count;
+}
+
+void accumulateBoidNeighbors(eSimdLevel level, const BoidNeighborBatch& batch, const glm::vec3& position, float visualRangeSqr, float minDistanceSqr, BoidNeighborSums& sums) {
+	assert(level <= detectSimdLevel()); // the cpu can't run this kernel
+
+	size_t i = 0;
+#if BOIDS_KERNEL_X86
+	if (level == eSimdLevel::AVX2) {
+		i = accumulateAVX2(batch, position, visualRangeSqr, minDistanceSqr, sums);
+	}
+	else if (level == eSimdLevel::SSE2) {
+		i = accumulateSSE2(batch, position, visualRangeSqr, minDistanceSqr, sums);
+	}
+#endif
+
+	// scalar path, also handles the neighbors left after the last full batch
+	for (; i < batch.count; i++) {
+		const glm::vec3 neighbor = glm::vec3(batch.positionX[i], batch.positionY[i], batch.positionZ[i]);
+		const glm::vec3 offset = position - neighbor;
+		const float distanceSqr = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+		if (distanceSqr < visualRangeSqr) {
+			sums.center += neighbor;
+			sums.velocity += glm::vec3(batch.velocityX[i], batch.velocityY[i], batch.velocityZ[i]);
+			sums.numNeighbors += 1;
+		}
+		if (distanceSqr < minDistanceSqr) {
+			sums.move += offset;
+		}
+	}
+}
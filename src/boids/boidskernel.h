@@ -0,0 +1,42 @@
+#pragma once
+
+#include "boidswarm.h"
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+enum class eSimdLevel : int {
+	Scalar = 0,
+	SSE2,
+	AVX2,
+};
+
+// Highest instruction set supported by both the CPU and the OS, read once from CPUID
+eSimdLevel detectSimdLevel();
+
+char const* simdLevelName(eSimdLevel level);
+
+// Neighbors of one boid copied next to each other, so that the kernels can load them by batches
+struct BoidNeighborBatch {
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> velocityX;
+	std::vector<float> velocityY;
+	std::vector<float> velocityZ;
+	size_t count = 0;
+};
+
+// Copies the candidates of boid, except boid itself, from boids into batch
+void gatherBoidNeighborBatch(BoidNeighborBatch& batch, const BoidSwarm& boids, size_t boid, const std::vector<int>& candidates);
+
+struct BoidNeighborSums {
+	glm::vec3 center = glm::vec3(0.f); // sum of the positions closer than visualRange
+	glm::vec3 velocity = glm::vec3(0.f); // sum of the velocities closer than visualRange
+	glm::vec3 move = glm::vec3(0.f); // sum of the offsets to the positions closer than minDistance
+	int numNeighbors = 0; // number of positions closer than visualRange
+};
+
+// Accumulates the neighbors of position stored in batch into sums. Distances are compared squared, AVX2 tests
+// 8 neighbors at a time and SSE2 4, using masks instead of branches. level must not be above detectSimdLevel().
+void accumulateBoidNeighbors(eSimdLevel level, const BoidNeighborBatch& batch, const glm::vec3& position, float visualRangeSqr, float minDistanceSqr, BoidNeighborSums& sums);
@@ -1,6 +1,10 @@
 #include "../viewer.h"
 #include "../drawbuffer.h"
 #include "../renderapi.h"
+#include "../threadpool.h"
+#include "spatialgrid.h"
+#include "boidswarm.h"
+#include "boidskernel.h"
 
 #include <random>
 #include <time.h>
@@ -12,6 +16,7 @@
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <iostream>
+#include <chrono>
 
 #define COUNTOF(ARRAY) (sizeof(ARRAY) / sizeof(ARRAY[0]))
 
@@ -20,16 +25,28 @@ constexpr glm::vec4 boidsWhite = { 1.f, 1.f, 1.f, 1.f };
 constexpr glm::vec4 boidsBlue = { 0.f, 0.f, 1.f, 1.f };
 constexpr glm::vec4 boidsGreen = { 0.f, 1.f, 0.f, 1.f };
 
-const int numBoids = 100;
+enum class eBoidsNeighborSearch : int {
+	BruteForce = 0, // reference mode, every boid tests every other boid
+	Grid, // only the boids stored in the neighboring cells of a SpatialGrid are tested
+};
+
+enum class eBoidsRuleKernel : int {
+	Separate = 0, // flyTowardsCenter, avoidOthers and matchVelocity each walk the neighbors, kept for validation
+	Fused, // applyRulesFused gathers the three rules in a single walk
+	Simd, // applyRulesSimd runs the fused rules with the vectorized accumulateBoidNeighbors
+};
 
-class Boid 
+// Per thread storage used while computing the new velocity of a boid
+struct BoidsScratch
 {
-public:
-	glm::vec3 Position;
-	glm::vec3 Velocity;
-	Boid(glm::vec3 position, glm::vec3 velocity) : Position(position), Velocity(velocity) { }
+	std::vector<int> candidates;
+	BoidNeighborBatch batch;
 };
 
+enum class eBoidsUpdateMode : int {
+	InPlace = 0, // velocities are changed while later boids still read them, the result depends on the iteration order
+	DoubleBuffered, // frame N is read from swarm, frame N+1 is written to nextSwarm by the worker threads
+};
 
 struct BoidsVertexShaderAdditionalData 
 {
@@ -53,12 +70,29 @@ struct BoidsViewer : Viewer
 	float centeringFactor = 0.03; // (fly towards center) Adjust velocity by this %
 	float matchingFactor = 0.05; // Adjust by this % of average velocity
 	glm::vec3 bounds = glm::vec3(10, 10, 10);
-	std::vector<Boid*> boidList = { };
+	int boidCount = 100;
+	eBoidsNeighborSearch neighborSearch = eBoidsNeighborSearch::Grid;
+	eBoidsRuleKernel ruleKernel = eBoidsRuleKernel::Fused;
+	eBoidsUpdateMode updateMode = eBoidsUpdateMode::DoubleBuffered;
+	int workerCount = 0;
+	BoidSwarm swarm;
+	BoidSwarm nextSwarm; // written by the double buffered update, then swapped with swarm
+
+	SpatialGrid grid;
+	ThreadPool threadPool;
+	BoidsScratch inPlaceScratch;
+	eSimdLevel simdLevel = eSimdLevel::Scalar; // level used by the Simd rule kernel, at most detectSimdLevel()
+	float simdMaxError = 0.f;
+	int simdNeighborCountMismatches = -1; // -1 until validateSimdKernel() runs
+	float updateDurationMs = 0.f;
+	float averageCandidateCount = 0.f;
 
 	BoidsVertexShaderAdditionalData additionalShaderData;
 
 	BoidsViewer() : Viewer(boidsViewerName, 1280, 720) {}
 
+	~BoidsViewer() { deleteThreadPool(threadPool); }
+
 	void init() override {
 		mousePos = { 0.f, 0.f };
 		leftMouseButtonPressed = false;
@@ -66,14 +100,70 @@ struct BoidsViewer : Viewer
 		altKeyPressed = false;
 
 		additionalShaderData.Pos = { 0.,0.,0. };
-		for (size_t i = 0; i < numBoids; i++)
+		simdLevel = detectSimdLevel();
+		workerCount = defaultThreadPoolWorkerCount();
+		createThreadPool(threadPool, workerCount);
+		spawnBoids();
+	}
+
+	glm::vec3 randomBoidPosition() const
+	{
+		return glm::vec3(std::rand() / float(RAND_MAX) * 20 - 10, std::rand() / float(RAND_MAX) * 20 - 10, std::rand() / float(RAND_MAX) * 20 - 10);
+	}
+
+	glm::vec3 randomBoidVelocity() const
+	{
+		return glm::vec3((std::rand() % 2 - 1) * .1f, (std::rand() % 2 - 1) * .1f, (std::rand() % 2 - 1) * .1f);
+	}
+
+	void spawnBoids()
+	{
+		swarm.clear();
+		swarm.reserve(boidCount);
+		for (int i = 0; i < boidCount; i++)
 		{
-			boidList.push_back(new Boid(glm::vec3(std::rand() % 20 - 10, std::rand() % 20 - 10, std::rand() % 20 - 10),
-				glm::vec3((std::rand() % 2 - 1) * .1f, (std::rand() % 2 - 1) * .1f, (std::rand() % 2 - 1) * .1f)));
+			swarm.add(randomBoidPosition(), randomBoidVelocity());
+		}
+	}
+
+	// Grow or shrink the flock to boidCount without respawning the boids already flying
+	void resizeSwarm()
+	{
+		while (swarm.count > size_t(boidCount))
+		{
+			swarm.remove(std::rand() % swarm.count);
+		}
+		swarm.reserve(boidCount);
+		while (swarm.count < size_t(boidCount))
+		{
+			swarm.add(randomBoidPosition(), randomBoidVelocity());
+		}
+	}
+
+	// Radius in which a boid can be influenced by another one, it is also the grid cell size
+	float neighborRadius() const
+	{
+		return glm::max(visualRange, minDistance);
+	}
+
+	// Fill candidates with the boids that may be in range of position, they still have to be distance tested
+	void gatherNeighborCandidates(const glm::vec3& position, std::vector<int>& candidates) const
+	{
+		candidates.clear();
+		if (neighborSearch == eBoidsNeighborSearch::Grid)
+		{
+			grid.gather(position, neighborRadius(), candidates);
+		}
+		else
+		{
+			for (size_t i = 0; i < swarm.count; i++)
+			{
+				candidates.push_back(int(i));
+			}
 		}
 	}
 
-	float distance(glm::vec3 position1, glm::vec3 position2) {
+	float distance(glm::vec3 position1, glm::vec3 position2) const {
 		float xSqr = (position1.x - position2.x) * (position1.x - position2.x);
 		float ySqr = (position1.y - position2.y) * (position1.y - position2.y);
 		float zSqr = (position1.z - position2.z) * (position1.z - position2.z);
@@ -83,15 +173,19 @@ struct BoidsViewer : Viewer
 		return sqrt(sqr);
 	}
 
-	void flyTowardsCenter(Boid* boid) {
+	// The rules read the flock from boids and accumulate into velocity, the velocity being computed for boid.
+	// The boid own velocity is always read from velocity so that a rule sees the changes of the previous ones.
 
+	void flyTowardsCenter(const BoidSwarm& boids, size_t boid, glm::vec3& velocity, const std::vector<int>& candidates) const {
+
+		const glm::vec3 position = boids.position(boid);
 		glm::vec3 center = glm::vec3(0, 0, 0);
 		int numNeighbors = 0;
 
-		for (size_t i = 0; i < boidList.size(); i++) 
+		for (int i : candidates)
 		{
-			if (distance(boid->Position, boidList[i]->Position) < visualRange) {
-				center += boidList[i]->Position;
+			if (distance(position, boids.position(i)) < visualRange) {
+				center += boids.position(i);
 				numNeighbors += 1;
 			}
 		}
@@ -99,23 +193,22 @@ struct BoidsViewer : Viewer
 		if (numNeighbors) {
 			center = glm::vec3(center.x / numNeighbors, center.y / numNeighbors, center.z / numNeighbors);
 
-			boid->Velocity.x += (center.x - boid->Position.x) * centeringFactor;
-			boid->Velocity.y += (center.y - boid->Position.y) * centeringFactor;
-			boid->Velocity.z += (center.z - boid->Position.z) * centeringFactor;
+			velocity += (center - position) * centeringFactor;
 		}
 	}
 
 	// Find the average velocity (speed and direction) of the other boids and
 	// adjust velocity slightly to match.
-	void matchVelocity(Boid* boid) 
+	void matchVelocity(const BoidSwarm& boids, size_t boid, glm::vec3& velocity, const std::vector<int>& candidates) const
 	{
+		const glm::vec3 position = boids.position(boid);
 		glm::vec3 averageVelocity = glm::vec3(0, 0, 0);
 		int numNeighbors = 0;
 
-		for (size_t i = 0; i < boidList.size(); i++) 
+		for (int i : candidates)
 		{
-			if (distance(boid->Position, boidList[i]->Position) < visualRange) {
-				averageVelocity += boidList[i]->Velocity;
+			if (distance(position, boids.position(i)) < visualRange) {
+				averageVelocity += size_t(i) == boid ? velocity : boids.velocity(i);
 				numNeighbors += 1;
 			}
 		}
@@ -126,76 +219,265 @@ struct BoidsViewer : Viewer
 			averageVelocity.y = averageVelocity.y / numNeighbors;
 			averageVelocity.z = averageVelocity.z / numNeighbors;
 
-			boid->Velocity += averageVelocity * matchingFactor;
+			velocity += averageVelocity * matchingFactor;
+		}
+	}
+
+	// Applies the three rules from the neighbor sums of boid, the boid itself being left out of the sums
+	void applyNeighborSums(const glm::vec3& position, BoidNeighborSums sums, glm::vec3& velocity) const
+	{
+		const bool selfInRange = 0.f < visualRange;
+		if (selfInRange) {
+			sums.center += position;
+			sums.numNeighbors += 1;
+		}
+
+		if (sums.numNeighbors) {
+			const glm::vec3 center = sums.center / float(sums.numNeighbors);
+			velocity += (center - position) * centeringFactor;
+		}
+
+		velocity += sums.move * avoidFactor;
+
+		if (sums.numNeighbors) {
+			// matchVelocity reads the boid own velocity once the two other rules are applied
+			glm::vec3 averageVelocity = sums.velocity + (selfInRange ? velocity : glm::vec3(0, 0, 0));
+			averageVelocity /= float(sums.numNeighbors);
+			velocity += averageVelocity * matchingFactor;
+		}
+	}
+
+	// Same result as flyTowardsCenter, avoidOthers then matchVelocity, but the neighbors are
+	// only walked once and compared with squared distances.
+	void applyRulesFused(const BoidSwarm& boids, size_t boid, glm::vec3& velocity, const std::vector<int>& candidates) const
+	{
+		const float visualRangeSqr = visualRange * visualRange;
+		const float minDistanceSqr = minDistance * minDistance;
+
+		const float* positionX = boids.positionX();
+		const float* positionY = boids.positionY();
+		const float* positionZ = boids.positionZ();
+		const float* velocityX = boids.velocityX();
+		const float* velocityY = boids.velocityY();
+		const float* velocityZ = boids.velocityZ();
+
+		const glm::vec3 position = boids.position(boid);
+		BoidNeighborSums sums;
+
+		for (int i : candidates)
+		{
+			if (size_t(i) == boid) {
+				continue;
+			}
+
+			const glm::vec3 offset = glm::vec3(position.x - positionX[i], position.y - positionY[i], position.z - positionZ[i]);
+			const float distanceSqr = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+
+			if (distanceSqr < visualRangeSqr) {
+				sums.center += glm::vec3(positionX[i], positionY[i], positionZ[i]);
+				sums.velocity += glm::vec3(velocityX[i], velocityY[i], velocityZ[i]);
+				sums.numNeighbors += 1;
+			}
+
+			if (distanceSqr < minDistanceSqr) {
+				sums.move += offset;
+			}
 		}
+
+		applyNeighborSums(position, sums, velocity);
+	}
+
+	// Fused rules where the candidates are first copied next to each other, then tested by batches
+	// with the instruction set selected in simdLevel.
+	void applyRulesSimd(const BoidSwarm& boids, size_t boid, glm::vec3& velocity, BoidsScratch& scratch) const
+	{
+		gatherBoidNeighborBatch(scratch.batch, boids, boid, scratch.candidates);
+
+		const glm::vec3 position = boids.position(boid);
+		BoidNeighborSums sums;
+		accumulateBoidNeighbors(simdLevel, scratch.batch, position, visualRange * visualRange, minDistance * minDistance, sums);
+
+		applyNeighborSums(position, sums, velocity);
 	}
 
 	// Speed will naturally vary in flocking behavior, but real animals can't go
 	// arbitrarily fast.
-	void limitSpeed(Boid* boid) {
+	void limitSpeed(glm::vec3& velocity) const {
 
-		float speed = sqrt(boid->Velocity.x * boid->Velocity.x + boid->Velocity.y * boid->Velocity.y + boid->Velocity.z * boid->Velocity.z);
+		float speed = sqrt(velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z);
 		if (speed > speedLimit) 
 		{
-			boid->Velocity.x = (boid->Velocity.x / speed) * speedLimit;
-			boid->Velocity.y = (boid->Velocity.y / speed) * speedLimit;
-			boid->Velocity.z = (boid->Velocity.z / speed) * speedLimit;
+			velocity = (velocity / speed) * speedLimit;
 		}
 	}
 
 	// Move away from other boids that are too close to avoid colliding
-	void avoidOthers(Boid* boid) {
+	void avoidOthers(const BoidSwarm& boids, size_t boid, glm::vec3& velocity, const std::vector<int>& candidates) const {
 
-		float moveX = 0;
-		float moveY = 0;
-		float moveZ = 0;
+		const glm::vec3 position = boids.position(boid);
+		glm::vec3 move = glm::vec3(0, 0, 0);
 
-		for (size_t i = 0; i < boidList.size(); i++) 
+		for (int i : candidates)
 		{
-			if (boidList[i] != boid) {
-				if (distance(boid->Position, boidList[i]->Position) < minDistance) 
+			if (size_t(i) != boid) {
+				if (distance(position, boids.position(i)) < minDistance) 
 				{
-					moveX += boid->Position.x - boidList[i]->Position.x;
-					moveY += boid->Position.y - boidList[i]->Position.y;
-					moveZ += boid->Position.z - boidList[i]->Position.z;
+					move += position - boids.position(i);
 				}
 			}
 		}
 
-		boid->Velocity.x += moveX * avoidFactor;
-		boid->Velocity.y += moveY * avoidFactor;
-		boid->Velocity.z += moveZ * avoidFactor;
+		velocity += move * avoidFactor;
 	}
 
 	// Constrain a boid to within the window. If it gets too close to an edge,
 	// nudge it back in and reverse its direction.
-	void keepWithinBounds(Boid* boid) 
+	void keepWithinBounds(const glm::vec3& position, glm::vec3& velocity) const
 	{
-		if (boid->Position.x < -bounds.x / 2) 
+		if (position.x < -bounds.x / 2) 
 		{
-			boid->Velocity.x += turnFactor;
+			velocity.x += turnFactor;
 		}
-		else if (boid->Position.x > bounds.x / 2) 
+		else if (position.x > bounds.x / 2) 
 		{
-			boid->Velocity.x -= turnFactor;
+			velocity.x -= turnFactor;
 		}
 
-		if (boid->Position.y < 0) 
+		if (position.y < 0) 
 		{
-			boid->Velocity.y += turnFactor;
+			velocity.y += turnFactor;
 		}
-		else if (boid->Position.y > bounds.y) 
+		else if (position.y > bounds.y) 
 		{
-			boid->Velocity.y -= turnFactor;
+			velocity.y -= turnFactor;
 		}
 
-		if (boid->Position.z < -bounds.z / 2) 
+		if (position.z < -bounds.z / 2) 
 		{
-			boid->Velocity.z += turnFactor;
+			velocity.z += turnFactor;
 		}
-		else if (boid->Position.z > bounds.z / 2) 
+		else if (position.z > bounds.z / 2) 
 		{
-			boid->Velocity.z -= turnFactor;
+			velocity.z -= turnFactor;
+		}
+	}
+
+	// Runs every rule for boid reading the flock from boids, returns its new velocity
+	glm::vec3 computeBoidVelocity(const BoidSwarm& boids, size_t boid, BoidsScratch& scratch) const
+	{
+		const std::vector<int>& candidates = scratch.candidates;
+		glm::vec3 velocity = boids.velocity(boid);
+
+		if (ruleKernel == eBoidsRuleKernel::Simd)
+		{
+			applyRulesSimd(boids, boid, velocity, scratch);
+		}
+		else if (ruleKernel == eBoidsRuleKernel::Fused)
+		{
+			applyRulesFused(boids, boid, velocity, candidates);
+		}
+		else
+		{
+			flyTowardsCenter(boids, boid, velocity, candidates);
+			avoidOthers(boids, boid, velocity, candidates);
+			matchVelocity(boids, boid, velocity, candidates);
+		}
+		limitSpeed(velocity);
+		keepWithinBounds(boids.position(boid), velocity);
+
+		return velocity;
+	}
+
+	// Reference path: each boid velocity is written back before the next boid reads it
+	size_t updateInPlace()
+	{
+		size_t candidateCount = 0;
+		for (size_t i = 0; i < swarm.count; i++)
+		{
+			gatherNeighborCandidates(swarm.position(i), inPlaceScratch.candidates);
+			candidateCount += inPlaceScratch.candidates.size();
+
+			swarm.setVelocity(i, computeBoidVelocity(swarm, i, inPlaceScratch));
+		}
+
+		float* positionX = swarm.positionX();
+		float* positionY = swarm.positionY();
+		float* positionZ = swarm.positionZ();
+		const float* velocityX = swarm.velocityX();
+		const float* velocityY = swarm.velocityY();
+		const float* velocityZ = swarm.velocityZ();
+		for (size_t i = 0; i < swarm.count; i++)
+		{
+			positionX[i] += velocityX[i];
+			positionY[i] += velocityY[i];
+			positionZ[i] += velocityZ[i];
+		}
+
+		return candidateCount;
+	}
+
+	// Every boid only reads frame N from swarm and writes its own slot of frame N+1 in nextSwarm,
+	// so the boids can be split across threads and the result does not depend on the thread count.
+	size_t updateDoubleBuffered()
+	{
+		nextSwarm.resize(swarm.count);
+
+		std::atomic<size_t> candidateCount{ 0 };
+		constexpr size_t boidsPerTask = 256;
+		parallelFor(threadPool, swarm.count, boidsPerTask, [&](size_t begin, size_t end) {
+			BoidsScratch scratch;
+			size_t rangeCandidateCount = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				gatherNeighborCandidates(swarm.position(i), scratch.candidates);
+				rangeCandidateCount += scratch.candidates.size();
+
+				const glm::vec3 velocity = computeBoidVelocity(swarm, i, scratch);
+				nextSwarm.setVelocity(i, velocity);
+				nextSwarm.setPosition(i, swarm.position(i) + velocity);
+			}
+			candidateCount += rangeCandidateCount;
+		});
+
+		swarm.swap(nextSwarm);
+
+		return candidateCount;
+	}
+
+	// Compares the sums of the vectorized kernel at simdLevel with the scalar ones for every boid of the current flock
+	void validateSimdKernel()
+	{
+		if (neighborSearch == eBoidsNeighborSearch::Grid)
+		{
+			grid.build(swarm.count, neighborRadius(), [this](size_t i) { return swarm.position(i); });
+		}
+
+		const float visualRangeSqr = visualRange * visualRange;
+		const float minDistanceSqr = minDistance * minDistance;
+
+		BoidsScratch scratch;
+		simdMaxError = 0.f;
+		simdNeighborCountMismatches = 0;
+		for (size_t i = 0; i < swarm.count; i++)
+		{
+			gatherNeighborCandidates(swarm.position(i), scratch.candidates);
+			gatherBoidNeighborBatch(scratch.batch, swarm, i, scratch.candidates);
+
+			BoidNeighborSums scalarSums;
+			accumulateBoidNeighbors(eSimdLevel::Scalar, scratch.batch, swarm.position(i), visualRangeSqr, minDistanceSqr, scalarSums);
+			BoidNeighborSums simdSums;
+			accumulateBoidNeighbors(simdLevel, scratch.batch, swarm.position(i), visualRangeSqr, minDistanceSqr, simdSums);
+
+			if (scalarSums.numNeighbors != simdSums.numNeighbors)
+			{
+				simdNeighborCountMismatches++;
+			}
+			const glm::vec3 centerError = glm::abs(scalarSums.center - simdSums.center);
+			const glm::vec3 velocityError = glm::abs(scalarSums.velocity - simdSums.velocity);
+			const glm::vec3 moveError = glm::abs(scalarSums.move - simdSums.move);
+			simdMaxError = glm::max(simdMaxError, glm::max(glm::max(centerError.x, centerError.y), centerError.z));
+			simdMaxError = glm::max(simdMaxError, glm::max(glm::max(velocityError.x, velocityError.y), velocityError.z));
+			simdMaxError = glm::max(simdMaxError, glm::max(glm::max(moveError.x, moveError.y), moveError.z));
 		}
 	}
 
@@ -214,19 +496,21 @@ struct BoidsViewer : Viewer
 		pCustomShaderData = &additionalShaderData;
 		CustomShaderDataSize = sizeof(BoidsVertexShaderAdditionalData);
 
-		for (size_t i = 0; i < boidList.size(); i++)
-		{
-			flyTowardsCenter(boidList[i]);
-			avoidOthers(boidList[i]);
-			matchVelocity(boidList[i]);
-			limitSpeed(boidList[i]);
-			keepWithinBounds(boidList[i]);
-		}
+		resizeSwarm();
+		resizeThreadPool(threadPool, workerCount);
 
-		for (size_t i = 0; i < boidList.size(); i++)
+		const auto updateStart = std::chrono::high_resolution_clock::now();
+
+		if (neighborSearch == eBoidsNeighborSearch::Grid)
 		{
-			boidList[i]->Position += boidList[i]->Velocity;
+			grid.build(swarm.count, neighborRadius(), [this](size_t i) { return swarm.position(i); });
 		}
+
+		const size_t candidateCount = updateMode == eBoidsUpdateMode::DoubleBuffered ? updateDoubleBuffered() : updateInPlace();
+
+		const auto updateEnd = std::chrono::high_resolution_clock::now();
+		updateDurationMs = std::chrono::duration<float, std::milli>(updateEnd - updateStart).count();
+		averageCandidateCount = swarm.count == 0 ? 0.f : candidateCount / float(swarm.count);
 	}
 
 	void render3D_custom(const RenderApi3D& api) const override 
@@ -239,15 +523,24 @@ struct BoidsViewer : Viewer
 		//api.grid(10.f, 10, glm::vec4(0.5f, 0.5f, 0.5f, 1.f), nullptr);
 		//api.axisXYZ(nullptr);
 
-		for (size_t i = 0; i < boidList.size(); i++)
+		std::vector<glm::vec3> positions(swarm.count);
+		for (size_t i = 0; i < swarm.count; i++)
+		{
+			positions[i] = swarm.position(i);
+		}
+		std::vector<float> radii(swarm.count, 0.2f);
+		std::vector<glm::vec4> colors(swarm.count, boidsGreen);
+		api.instancedSpheres(positions.data(), radii.data(), colors.data(), (unsigned int)swarm.count);
+
+		for (size_t i = 0; i < swarm.count; i++)
 		{
-			api.solidSphere(boidList[i]->Position, 0.2f, 10, 10, boidsGreen);
+			const glm::vec3 position = positions[i];
 			glm::vec3 vertices[2] =
 			{
-				boidList[i]->Position,
-				boidList[i]->Position + boidList[i]->Velocity * glm::vec3(2, 2, 2)
+				position,
+				position + swarm.velocity(i) * glm::vec3(2, 2, 2)
 			};
-			api.lines(vertices, 24, glm::vec4(0.5f, 0.5f, 0.5f, 1.f), nullptr);
+			api.lines(vertices, 2, glm::vec4(0.5f, 0.5f, 0.5f, 1.f), nullptr);
 		}
 
 		glm::vec3 vertices[24] =
@@ -337,6 +630,48 @@ struct BoidsViewer : Viewer
 		ImGui::SliderFloat3("Bounds Size", &bounds.x, 0, 100.f);
 		ImGui::Separator();
 
+		ImGui::SliderInt("Boid count", &boidCount, 1, 100000);
+		if (ImGui::Button("Respawn boids"))
+		{
+			spawnBoids();
+		}
+		ImGui::RadioButton("Brute force", (int*)&neighborSearch, (int)eBoidsNeighborSearch::BruteForce);
+		ImGui::SameLine();
+		ImGui::RadioButton("Grid", (int*)&neighborSearch, (int)eBoidsNeighborSearch::Grid);
+		ImGui::RadioButton("Separate rules", (int*)&ruleKernel, (int)eBoidsRuleKernel::Separate);
+		ImGui::SameLine();
+		ImGui::RadioButton("Fused rules", (int*)&ruleKernel, (int)eBoidsRuleKernel::Fused);
+		ImGui::SameLine();
+		ImGui::RadioButton("SIMD rules", (int*)&ruleKernel, (int)eBoidsRuleKernel::Simd);
+		if (ruleKernel == eBoidsRuleKernel::Simd)
+		{
+			for (int level = 0; level <= (int)detectSimdLevel(); level++)
+			{
+				if (level > 0)
+				{
+					ImGui::SameLine();
+				}
+				ImGui::RadioButton(simdLevelName((eSimdLevel)level), (int*)&simdLevel, level);
+			}
+			if (ImGui::Button("Validate against scalar"))
+			{
+				validateSimdKernel();
+			}
+			if (simdNeighborCountMismatches >= 0)
+			{
+				ImGui::Text("%s max error %g, %d neighbor count mismatches", simdLevelName(simdLevel), simdMaxError, simdNeighborCountMismatches);
+			}
+		}
+		ImGui::RadioButton("In place", (int*)&updateMode, (int)eBoidsUpdateMode::InPlace);
+		ImGui::SameLine();
+		ImGui::RadioButton("Double buffered", (int*)&updateMode, (int)eBoidsUpdateMode::DoubleBuffered);
+		if (updateMode == eBoidsUpdateMode::DoubleBuffered)
+		{
+			ImGui::SliderInt("Worker threads", &workerCount, 0, 2 * (defaultThreadPoolWorkerCount() + 1));
+		}
+		ImGui::Text("Boids update %.3f ms (%.1f candidates per boid)", updateDurationMs, averageCandidateCount);
+		ImGui::Separator();
+
 		float fovDegrees = glm::degrees(camera.fov);
 		if (ImGui::SliderFloat("Camera field of fiew (degrees)", &fovDegrees, 15, 180)) {
 			camera.fov = glm::radians(fovDegrees);
@@ -344,6 +679,7 @@ struct BoidsViewer : Viewer
 
 
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		drawRenderStatsGUI();
 
 		ImGui::End();
 
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <new>
+#include <utility>
+#include <string.h>
+#include <assert.h>
+
+// Structure of arrays storage of a flock. Every component of the positions and velocities
+// lives in its own contiguous, cache line aligned array, so a pass over the flock streams
+// linearly through memory. The capacity is kept a multiple of Lanes so vectorized loops
+// can read whole batches past count.
+struct BoidSwarm
+{
+	enum {
+		PositionX = 0,
+		PositionY,
+		PositionZ,
+		VelocityX,
+		VelocityY,
+		VelocityZ,
+		StreamCount
+	};
+	static constexpr size_t Alignment = 64;
+	static constexpr size_t Lanes = 8;
+
+	float* streams[StreamCount] = {};
+	size_t count = 0;
+	size_t capacity = 0;
+
+	BoidSwarm() = default;
+	BoidSwarm(const BoidSwarm&) = delete;
+	BoidSwarm& operator=(const BoidSwarm&) = delete;
+	~BoidSwarm() { release(); }
+
+	float* positionX() const { return streams[PositionX]; }
+	float* positionY() const { return streams[PositionY]; }
+	float* positionZ() const { return streams[PositionZ]; }
+	float* velocityX() const { return streams[VelocityX]; }
+	float* velocityY() const { return streams[VelocityY]; }
+	float* velocityZ() const { return streams[VelocityZ]; }
+
+	glm::vec3 position(size_t i) const { return glm::vec3(streams[PositionX][i], streams[PositionY][i], streams[PositionZ][i]); }
+	glm::vec3 velocity(size_t i) const { return glm::vec3(streams[VelocityX][i], streams[VelocityY][i], streams[VelocityZ][i]); }
+
+	void setPosition(size_t i, const glm::vec3& position)
+	{
+		streams[PositionX][i] = position.x;
+		streams[PositionY][i] = position.y;
+		streams[PositionZ][i] = position.z;
+	}
+
+	void setVelocity(size_t i, const glm::vec3& velocity)
+	{
+		streams[VelocityX][i] = velocity.x;
+		streams[VelocityY][i] = velocity.y;
+		streams[VelocityZ][i] = velocity.z;
+	}
+
+	void reserve(size_t newCapacity)
+	{
+		newCapacity = (newCapacity + Lanes - 1) / Lanes * Lanes;
+		if (newCapacity <= capacity)
+		{
+			return;
+		}
+
+		for (int stream = 0; stream < StreamCount; stream++)
+		{
+			float* newStream = static_cast<float*>(::operator new(newCapacity * sizeof(float), std::align_val_t(Alignment)));
+			memset(newStream, 0, newCapacity * sizeof(float));
+			if (streams[stream])
+			{
+				memcpy(newStream, streams[stream], count * sizeof(float));
+				::operator delete(streams[stream], std::align_val_t(Alignment));
+			}
+			streams[stream] = newStream;
+		}
+		capacity = newCapacity;
+	}
+
+	// New boids are zero initialized
+	void resize(size_t newCount)
+	{
+		reserve(newCount);
+		for (int stream = 0; stream < StreamCount && newCount < count; stream++)
+		{
+			memset(streams[stream] + newCount, 0, (count - newCount) * sizeof(float));
+		}
+		count = newCount;
+	}
+
+	void swap(BoidSwarm& other)
+	{
+		for (int stream = 0; stream < StreamCount; stream++)
+		{
+			std::swap(streams[stream], other.streams[stream]);
+		}
+		std::swap(count, other.count);
+		std::swap(capacity, other.capacity);
+	}
+
+	// Returns the index of the new boid
+	size_t add(const glm::vec3& position, const glm::vec3& velocity)
+	{
+		if (count == capacity)
+		{
+			reserve(capacity ? capacity * 2 : 64);
+		}
+		setPosition(count, position);
+		setVelocity(count, velocity);
+		return count++;
+	}
+
+	// Swap with the last boid and pop, so the index of the last boid changes to index
+	void remove(size_t index)
+	{
+		assert(index < count);
+		--count;
+		for (int stream = 0; stream < StreamCount; stream++)
+		{
+			streams[stream][index] = streams[stream][count];
+			streams[stream][count] = 0.f;
+		}
+	}
+
+	void clear()
+	{
+		for (int stream = 0; stream < StreamCount && streams[stream]; stream++)
+		{
+			memset(streams[stream], 0, count * sizeof(float));
+		}
+		count = 0;
+	}
+
+	void release()
+	{
+		for (int stream = 0; stream < StreamCount; stream++)
+		{
+			::operator delete(streams[stream], std::align_val_t(Alignment));
+			streams[stream] = nullptr;
+		}
+		count = 0;
+		capacity = 0;
+	}
+};
@@ -0,0 +1,850 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec2.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+// Distance constraint between two particles of a Cloth, referenced by index
+struct ClothConstraint
+{
+	int p1;
+	int p2;
+	float restDistance; // the length between p1 and p2 in rest configuration
+	float compliance; // inverse stiffness used by the XPBD projection, 0 is perfectly stiff
+	float lambda; // XPBD Lagrange multiplier, accumulated over the iterations of a substep
+};
+
+// Dihedral angle constraint between the triangles (p1, p2, p3) and (p1, p2, p4) sharing the edge p1 p2
+struct ClothBendingConstraint
+{
+	int p1;
+	int p2;
+	int p3;
+	int p4;
+	float restAngle; // signed dihedral angle, 0 when the triangles are flat
+	float compliance;
+	float lambda;
+};
+
+// Signed angle between the normals n1 = (p2 - p1) x (p3 - p1) and n2 = (p4 - p1) x (p2 - p1), which are equal when the triangles
+// are flat, measured around the edge p1 p2. Unlike the unsigned angle it is smooth at flat and tells a fold from its mirror.
+inline float clothDihedralAngle(const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, const glm::vec3& p4)
+{
+	const glm::vec3 edge = p2 - p1;
+	const glm::vec3 n1 = glm::cross(edge, p3 - p1);
+	const glm::vec3 n2 = glm::cross(p4 - p1, edge);
+	const float edgeLength = glm::length(edge);
+	return edgeLength > 0.f ? atan2f(glm::dot(glm::cross(n2, n1), edge) / edgeLength, glm::dot(n1, n2)) : 0.f;
+}
+
+// Independent cloth packed in a Cloth: a width x height grid of particles stored row by row from firstParticle.
+// Its constraints, triangles and tethers never reach the particles of another grid.
+struct ClothGrid
+{
+	int firstParticle;
+	int width;
+	int height;
+
+	int particle(int x, int y) const { return firstParticle + y * width + x; }
+	int particleCount() const { return width * height; }
+};
+
+// Index of the grid holding particle, the grids being sorted by firstParticle. -1 when no grid holds it.
+inline int clothGridOf(const std::vector<ClothGrid>& grids, int particle)
+{
+	const auto next = std::upper_bound(grids.begin(), grids.end(), particle, [](int p, const ClothGrid& grid) {
+		return p < grid.firstParticle;
+	});
+	if (next == grids.begin())
+	{
+		return -1;
+	}
+	const int g = int(next - grids.begin()) - 1;
+	return particle < grids[g].firstParticle + grids[g].particleCount() ? g : -1;
+}
+
+// Structure of arrays storage of a cloth: each particle attribute lives in its own contiguous
+// array and the constraints are packed index pairs, so the solver streams through memory.
+// Several grid cloths can share the arrays, so that every pass handles all of them at once.
+// Pinned particles have an inverse mass of 0.
+struct Cloth
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> oldPositions;
+	std::vector<glm::vec3> restPositions;
+	std::vector<glm::vec3> accelerations; // accumulated forces divided by mass, reset by every time step
+	std::vector<float> inverseMasses;
+
+	std::vector<ClothConstraint> constraints;
+	std::vector<ClothBendingConstraint> bendingConstraints;
+	unsigned int constraintsRevision = 0; // changes whenever constraints or bendingConstraints is modified, to refresh the data derived from them.
+	                                      // The O(1) removals keep it, the derived data is then updated in place by its own removal function.
+
+	std::vector<glm::ivec3> triangles; // surface of the cloth, counterclockwise
+	unsigned int trianglesRevision = 0; // changes whenever triangles is modified
+
+	// Long range attachments: particle p stays within tetherDistances[i] of the pinned particle tetherAnchors[i],
+	// for i in [tetherStart[p], tetherStart[p + 1])
+	std::vector<int> tetherStart;
+	std::vector<int> tetherAnchors;
+	std::vector<float> tetherDistances;
+
+	std::vector<ClothGrid> grids; // in the order of their particles
+
+	size_t particleCount() const { return positions.size(); }
+
+	// Keeps the capacity, so a new cloth of the same size does not allocate
+	void clear()
+	{
+		positions.clear();
+		oldPositions.clear();
+		restPositions.clear();
+		accelerations.clear();
+		inverseMasses.clear();
+		constraints.clear();
+		bendingConstraints.clear();
+		constraintsRevision++;
+		triangles.clear();
+		trianglesRevision++;
+		tetherStart.clear();
+		tetherAnchors.clear();
+		tetherDistances.clear();
+		grids.clear();
+	}
+
+	// Appends a grid of width x height particles at origin + (x * spacing.x, y * spacing.y, 0), returns its index
+	int addGrid(int width, int height, const glm::vec3& origin, const glm::vec2& spacing, float mass)
+	{
+		grids.push_back({ int(particleCount()), width, height });
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				addParticle(origin + glm::vec3(x * spacing.x, y * spacing.y, 0.f), mass);
+			}
+		}
+		return int(grids.size() - 1);
+	}
+
+	// Returns the index of the new particle
+	int addParticle(const glm::vec3& position, float mass)
+	{
+		assert(mass > 0.f);
+		positions.push_back(position);
+		oldPositions.push_back(position);
+		restPositions.push_back(position);
+		accelerations.push_back(glm::vec3(0.f));
+		inverseMasses.push_back(1.f / mass);
+		return int(positions.size() - 1);
+	}
+
+	void pin(int particle)
+	{
+		inverseMasses[particle] = 0.f;
+	}
+
+	bool isPinned(int particle) const
+	{
+		return inverseMasses[particle] == 0.f;
+	}
+
+	void addConstraint(int p1, int p2, float compliance = 0.f)
+	{
+		constraints.push_back({ p1, p2, glm::distance(positions[p1], positions[p2]), compliance, 0.f });
+		constraintsRevision++;
+	}
+
+	// The topology is unchanged, so constraintsRevision is kept: see setClothColoredCompliance
+	void setCompliance(float compliance)
+	{
+		for (ClothConstraint& constraint : constraints)
+		{
+			constraint.compliance = compliance;
+		}
+	}
+
+	void addTriangle(int p1, int p2, int p3)
+	{
+		triangles.push_back(glm::ivec3(p1, p2, p3));
+		trianglesRevision++;
+	}
+
+	// Swap with the last triangle and pop, trianglesRevision is kept: see removeClothTriangleAdjacencyTriangle
+	void removeTriangle(size_t triangle)
+	{
+		triangles[triangle] = triangles.back();
+		triangles.pop_back();
+	}
+
+	// One bending constraint across every edge shared by two triangles, the rest angles are measured on restPositions
+	void addBendingConstraints(float compliance)
+	{
+		struct TriangleEdge
+		{
+			int p1; // smallest index of the edge
+			int p2;
+			int opposite; // third particle of the triangle
+		};
+		std::vector<TriangleEdge> edges;
+		edges.reserve(3 * triangles.size());
+		for (const glm::ivec3& triangle : triangles)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				const int a = triangle[i];
+				const int b = triangle[(i + 1) % 3];
+				edges.push_back({ glm::min(a, b), glm::max(a, b), triangle[(i + 2) % 3] });
+			}
+		}
+		std::sort(edges.begin(), edges.end(), [](const TriangleEdge& e1, const TriangleEdge& e2) {
+			return e1.p1 != e2.p1 ? e1.p1 < e2.p1 : e1.p2 < e2.p2;
+		});
+
+		// a manifold edge appears exactly twice once sorted
+		for (size_t i = 0; i + 1 < edges.size(); i++)
+		{
+			const TriangleEdge& e1 = edges[i];
+			const TriangleEdge& e2 = edges[i + 1];
+			if (e1.p1 != e2.p1 || e1.p2 != e2.p2)
+			{
+				continue;
+			}
+			const float restAngle = clothDihedralAngle(restPositions[e1.p1], restPositions[e1.p2], restPositions[e1.opposite], restPositions[e2.opposite]);
+			bendingConstraints.push_back({ e1.p1, e1.p2, e1.opposite, e2.opposite, restAngle, compliance, 0.f });
+			i++;
+		}
+		constraintsRevision++;
+	}
+
+	// Like setCompliance, constraintsRevision is kept
+	void setBendingCompliance(float compliance)
+	{
+		for (ClothBendingConstraint& constraint : bendingConstraints)
+		{
+			constraint.compliance = compliance;
+		}
+	}
+
+	// Tethers every free particle to every pinned particle of its grid, at their distance in rest configuration.
+	// Without grids the whole cloth is one piece.
+	void attachTethers()
+	{
+		std::vector<ClothGrid> pieces = grids;
+		if (pieces.empty())
+		{
+			pieces.push_back({ 0, int(particleCount()), 1 });
+		}
+
+		tetherStart.assign(particleCount() + 1, 0);
+		tetherAnchors.clear();
+		tetherDistances.clear();
+		size_t p = 0;
+		std::vector<int> anchors;
+		for (const ClothGrid& piece : pieces)
+		{
+			const int end = piece.firstParticle + piece.particleCount();
+			anchors.clear();
+			for (int anchor = piece.firstParticle; anchor < end; anchor++)
+			{
+				if (isPinned(anchor))
+				{
+					anchors.push_back(anchor);
+				}
+			}
+
+			// particles outside of the grids have no tether
+			for (; p < size_t(piece.firstParticle); p++)
+			{
+				tetherStart[p + 1] = int(tetherAnchors.size());
+			}
+			for (; p < size_t(end); p++)
+			{
+				for (size_t i = 0; i < anchors.size() && !isPinned(int(p)); i++)
+				{
+					tetherAnchors.push_back(anchors[i]);
+					tetherDistances.push_back(glm::distance(restPositions[p], restPositions[anchors[i]]));
+				}
+				tetherStart[p + 1] = int(tetherAnchors.size());
+			}
+		}
+		for (; p < particleCount(); p++)
+		{
+			tetherStart[p + 1] = int(tetherAnchors.size());
+		}
+	}
+
+	size_t tetherCount() const { return tetherAnchors.size(); }
+
+	// Swap with the last constraint and pop, constraintsRevision is kept: see removeClothColoredConstraint and removeClothAdjacencyConstraint
+	void removeConstraint(size_t constraint)
+	{
+		constraints[constraint] = constraints.back();
+		constraints.pop_back();
+	}
+
+	// Swap with the last bending constraint and pop, constraintsRevision is kept: see removeClothColoredConstraint and removeClothBendingAdjacencyConstraint
+	void removeBendingConstraint(size_t constraint)
+	{
+		bendingConstraints[constraint] = bendingConstraints.back();
+		bendingConstraints.pop_back();
+	}
+};
+
+// Statistics of the relative constraint errors |C| / restDistance measured during a solver sweep
+struct ClothResidual
+{
+	float maxError = 0.f;
+	float sumSquaredError = 0.f;
+	size_t count = 0;
+
+	void add(float error)
+	{
+		maxError = glm::max(maxError, error);
+		sumSquaredError += error * error;
+		count++;
+	}
+
+	void merge(const ClothResidual& other)
+	{
+		maxError = glm::max(maxError, other.maxError);
+		sumSquaredError += other.sumSquaredError;
+		count += other.count;
+	}
+
+	float rmsError() const { return count ? sqrtf(sumSquaredError / float(count)) : 0.f; }
+};
+
+// Particles moved by a constraint, returns their count
+inline int clothConstraintParticles(const ClothConstraint& constraint, int particles[4])
+{
+	particles[0] = constraint.p1;
+	particles[1] = constraint.p2;
+	return 2;
+}
+
+inline int clothConstraintParticles(const ClothBendingConstraint& constraint, int particles[4])
+{
+	particles[0] = constraint.p1;
+	particles[1] = constraint.p2;
+	particles[2] = constraint.p3;
+	particles[3] = constraint.p4;
+	return 4;
+}
+
+// Constraints of a Cloth partitioned in colors: two constraints of the same color never share a
+// particle, so a whole color can be solved concurrently and the colors one after another.
+template <typename Constraint>
+struct ClothColoring
+{
+	static constexpr int MaxColorCount = 64;
+
+	std::vector<Constraint> constraints; // packed color by color
+	std::vector<int> colorStart; // colorCount + 1 offsets into constraints
+	std::vector<int> sources; // index of each colored constraint in the constraints it was built from
+	std::vector<int> slots; // index in constraints of each source constraint
+	unsigned int constraintsRevision = ~0u; // of the cloth constraints when built
+
+	int colorCount() const { return int(colorStart.size()) - 1; }
+	int colorSize(int color) const { return colorStart[color + 1] - colorStart[color]; }
+};
+
+// Keeps the colored copies in sync with cloth.setCompliance or cloth.setBendingCompliance, without coloring them again
+template <typename Constraint>
+void setClothColoredCompliance(ClothColoring<Constraint>& coloring, float compliance)
+{
+	for (Constraint& constraint : coloring.constraints)
+	{
+		constraint.compliance = compliance;
+	}
+}
+
+using ClothConstraintColoring = ClothColoring<ClothConstraint>;
+using ClothBendingColoring = ClothColoring<ClothBendingConstraint>;
+
+// Greedy coloring in constraint order, each constraint gets the first color unused by its particles.
+// Constraints that find no color among MaxColorCount share the last one, which is then not safe to
+// solve concurrently: lastColorConflicts tells if that happened.
+template <typename Constraint>
+void colorClothConstraints(const Cloth& cloth, const std::vector<Constraint>& constraints, ClothColoring<Constraint>& coloring, bool& lastColorConflicts)
+{
+	constexpr int MaxColorCount = ClothColoring<Constraint>::MaxColorCount;
+	std::vector<uint64_t> particleColors(cloth.particleCount(), 0); // bit c is set once the particle is in a constraint of color c
+	std::vector<int> constraintColors(constraints.size());
+	std::vector<int> colorSizes(MaxColorCount, 0);
+	int colorCount = 0;
+	lastColorConflicts = false;
+
+	for (size_t i = 0; i < constraints.size(); i++)
+	{
+		int particles[4];
+		const int particleCount = clothConstraintParticles(constraints[i], particles);
+		uint64_t usedColors = 0;
+		for (int j = 0; j < particleCount; j++)
+		{
+			usedColors |= particleColors[particles[j]];
+		}
+		int color = 0;
+		while (color < MaxColorCount - 1 && (usedColors & (uint64_t(1) << color)))
+		{
+			color++;
+		}
+		lastColorConflicts |= (usedColors & (uint64_t(1) << color)) != 0;
+
+		for (int j = 0; j < particleCount; j++)
+		{
+			particleColors[particles[j]] |= uint64_t(1) << color;
+		}
+		constraintColors[i] = color;
+		colorSizes[color]++;
+		colorCount = glm::max(colorCount, color + 1);
+	}
+
+	coloring.colorStart.resize(colorCount + 1);
+	coloring.colorStart[0] = 0;
+	for (int color = 0; color < colorCount; color++)
+	{
+		coloring.colorStart[color + 1] = coloring.colorStart[color] + colorSizes[color];
+	}
+
+	std::vector<int> colorEnd(coloring.colorStart.begin(), coloring.colorStart.end() - 1);
+	coloring.constraints.resize(constraints.size());
+	coloring.sources.resize(constraints.size());
+	coloring.slots.resize(constraints.size());
+	for (size_t i = 0; i < constraints.size(); i++)
+	{
+		const int slot = colorEnd[constraintColors[i]]++;
+		coloring.constraints[slot] = constraints[i];
+		coloring.sources[slot] = int(i);
+		coloring.slots[i] = slot;
+	}
+	coloring.constraintsRevision = cloth.constraintsRevision;
+}
+
+// Keeps coloring in sync when the source constraint is swapped with lastSource and popped from the constraints it was
+// built from, in O(colorCount): the hole left in its color is filled by the last constraint of the color, which moves
+// the hole to the next color, until it reaches the end of the last one. The colors stay valid, they only lose a constraint.
+template <typename Constraint>
+void removeClothColoredConstraint(ClothColoring<Constraint>& coloring, int source, int lastSource)
+{
+	int hole = coloring.slots[source];
+	const int color = int(std::upper_bound(coloring.colorStart.begin(), coloring.colorStart.end(), hole) - coloring.colorStart.begin()) - 1;
+	for (int c = color; c < coloring.colorCount(); c++)
+	{
+		const int last = --coloring.colorStart[c + 1];
+		if (last != hole) // not an empty color, nor the removed constraint being the last of its color
+		{
+			coloring.constraints[hole] = coloring.constraints[last];
+			coloring.sources[hole] = coloring.sources[last];
+			coloring.slots[coloring.sources[hole]] = hole;
+			hole = last;
+		}
+	}
+	coloring.constraints.pop_back();
+	coloring.sources.pop_back();
+
+	if (lastSource != source)
+	{
+		const int slot = coloring.slots[lastSource];
+		coloring.sources[slot] = source;
+		coloring.slots[source] = slot;
+	}
+	coloring.slots.pop_back();
+}
+
+// Removes entry from the row [start, end) of a compressed sparse row structure, the last entry of the row takes its place
+inline void removeClothRowEntry(std::vector<int>& entries, int start, int& end, int entry)
+{
+	for (int i = start; i < end; i++)
+	{
+		if (entries[i] == entry)
+		{
+			entries[i] = entries[--end];
+			return;
+		}
+	}
+}
+
+inline void renameClothRowEntry(std::vector<int>& entries, int start, int end, int entry, int newEntry)
+{
+	for (int i = start; i < end; i++)
+	{
+		if (entries[i] == entry)
+		{
+			entries[i] = newEntry;
+			return;
+		}
+	}
+}
+
+// Compressed sparse row adjacency of a Cloth: the constraints incident to particle p are
+// constraints[particleStart[p]] to constraints[particleEnd[p] - 1], as indices into Cloth::constraints.
+// The rows shrink when constraints are removed, but keep their start.
+struct ClothAdjacency
+{
+	std::vector<int> particleStart; // particleCount + 1 offsets into constraints
+	std::vector<int> particleEnd; // end of the entries still used in each row
+	std::vector<int> constraints;
+	unsigned int constraintsRevision = ~0u; // of the cloth constraints when built
+};
+
+inline void buildClothAdjacency(const Cloth& cloth, ClothAdjacency& adjacency)
+{
+	adjacency.particleStart.assign(cloth.particleCount() + 1, 0);
+	for (const ClothConstraint& constraint : cloth.constraints)
+	{
+		adjacency.particleStart[constraint.p1 + 1]++;
+		adjacency.particleStart[constraint.p2 + 1]++;
+	}
+	for (size_t p = 0; p < cloth.particleCount(); p++)
+	{
+		adjacency.particleStart[p + 1] += adjacency.particleStart[p];
+	}
+
+	std::vector<int> particleEnd(adjacency.particleStart.begin(), adjacency.particleStart.end() - 1);
+	adjacency.constraints.resize(2 * cloth.constraints.size());
+	for (size_t i = 0; i < cloth.constraints.size(); i++)
+	{
+		adjacency.constraints[particleEnd[cloth.constraints[i].p1]++] = int(i);
+		adjacency.constraints[particleEnd[cloth.constraints[i].p2]++] = int(i);
+	}
+	adjacency.particleEnd = std::move(particleEnd);
+	adjacency.constraintsRevision = cloth.constraintsRevision;
+}
+
+// Keeps adjacency in sync with cloth.removeConstraint(constraint), to be called before it
+inline void removeClothAdjacencyConstraint(const Cloth& cloth, ClothAdjacency& adjacency, int constraint)
+{
+	const ClothConstraint& removed = cloth.constraints[constraint];
+	removeClothRowEntry(adjacency.constraints, adjacency.particleStart[removed.p1], adjacency.particleEnd[removed.p1], constraint);
+	removeClothRowEntry(adjacency.constraints, adjacency.particleStart[removed.p2], adjacency.particleEnd[removed.p2], constraint);
+
+	const int last = int(cloth.constraints.size()) - 1;
+	if (last != constraint)
+	{
+		const ClothConstraint& moved = cloth.constraints[last];
+		renameClothRowEntry(adjacency.constraints, adjacency.particleStart[moved.p1], adjacency.particleEnd[moved.p1], last, constraint);
+		renameClothRowEntry(adjacency.constraints, adjacency.particleStart[moved.p2], adjacency.particleEnd[moved.p2], last, constraint);
+	}
+}
+
+// Buffers of detachClothTethers, kept between the calls so that they do not allocate
+struct ClothTetherScratch
+{
+	std::vector<int> pieces; // connected piece of each particle of the grids being detached
+	std::vector<int> stack;
+};
+
+// Removes the tethers of the particles of grids that the constraints no longer connect to their anchor, a piece torn off
+// would otherwise hang from the pinned particles. grids is sorted without duplicates, {-1} for a cloth without grids, the
+// other grids keep their tethers. One pass packs the tethers from the first grid on. adjacency must be up to date.
+inline void detachClothTethers(Cloth& cloth, const ClothAdjacency& adjacency, const std::vector<int>& grids, ClothTetherScratch& scratch)
+{
+	if (grids.empty())
+	{
+		return;
+	}
+	const auto gridBegin = [&](int grid) { return grid >= 0 ? cloth.grids[grid].firstParticle : 0; };
+	const auto gridEnd = [&](int grid) { return grid >= 0 ? gridBegin(grid) + cloth.grids[grid].particleCount() : int(cloth.particleCount()); };
+
+	// flood fill of the pieces of every grid, their constraints never leave them
+	scratch.pieces.resize(cloth.particleCount());
+	int pieceCount = 0;
+	for (int grid : grids)
+	{
+		const int first = gridBegin(grid);
+		const int last = gridEnd(grid);
+		std::fill(scratch.pieces.begin() + first, scratch.pieces.begin() + last, -1);
+		for (int seed = first; seed < last; seed++)
+		{
+			if (scratch.pieces[seed] != -1)
+			{
+				continue;
+			}
+			scratch.pieces[seed] = pieceCount;
+			scratch.stack.push_back(seed);
+			while (!scratch.stack.empty())
+			{
+				const int p = scratch.stack.back();
+				scratch.stack.pop_back();
+				for (int i = adjacency.particleStart[p]; i < adjacency.particleEnd[p]; i++)
+				{
+					const ClothConstraint& constraint = cloth.constraints[adjacency.constraints[i]];
+					const int other = constraint.p1 == p ? constraint.p2 : constraint.p1;
+					if (scratch.pieces[other] == -1)
+					{
+						scratch.pieces[other] = pieceCount;
+						scratch.stack.push_back(other);
+					}
+				}
+			}
+			pieceCount++;
+		}
+	}
+
+	// the tethers kept are packed in place, tetherStart[p + 1] is read before being overwritten. The tethers of the
+	// grids in between move down over the removed ones, and nothing moves any more once the last grid is done.
+	const int particleCount = int(cloth.particleCount());
+	int kept = cloth.tetherStart[gridBegin(grids.front())];
+	size_t next = 0; // first grid of grids not passed yet
+	for (int p = gridBegin(grids.front()); p < particleCount; p++)
+	{
+		while (next < grids.size() && p >= gridEnd(grids[next]))
+		{
+			next++;
+		}
+		if (next == grids.size() && kept == cloth.tetherStart[p])
+		{
+			break;
+		}
+		const bool detached = next < grids.size() && p >= gridBegin(grids[next]);
+		const int begin = cloth.tetherStart[p];
+		const int end = cloth.tetherStart[p + 1];
+		cloth.tetherStart[p] = kept;
+		for (int i = begin; i < end; i++)
+		{
+			if (!detached || scratch.pieces[cloth.tetherAnchors[i]] == scratch.pieces[p])
+			{
+				cloth.tetherAnchors[kept] = cloth.tetherAnchors[i];
+				cloth.tetherDistances[kept] = cloth.tetherDistances[i];
+				kept++;
+			}
+		}
+		if (p == particleCount - 1)
+		{
+			cloth.tetherStart[particleCount] = kept;
+		}
+	}
+	cloth.tetherAnchors.resize(cloth.tetherStart[particleCount]);
+	cloth.tetherDistances.resize(cloth.tetherStart[particleCount]);
+}
+
+// Bending constraints of a Cloth by their first hinge particle, the smallest one: constraints[particleStart[p]]
+// to constraints[particleEnd[p] - 1], as indices into Cloth::bendingConstraints
+struct ClothBendingAdjacency
+{
+	std::vector<int> particleStart; // particleCount + 1 offsets into constraints
+	std::vector<int> particleEnd; // end of the entries still used in each row
+	std::vector<int> constraints;
+	unsigned int constraintsRevision = ~0u; // of the cloth constraints when built
+};
+
+inline void buildClothBendingAdjacency(const Cloth& cloth, ClothBendingAdjacency& adjacency)
+{
+	adjacency.particleStart.assign(cloth.particleCount() + 1, 0);
+	for (const ClothBendingConstraint& constraint : cloth.bendingConstraints)
+	{
+		adjacency.particleStart[constraint.p1 + 1]++;
+	}
+	for (size_t p = 0; p < cloth.particleCount(); p++)
+	{
+		adjacency.particleStart[p + 1] += adjacency.particleStart[p];
+	}
+
+	adjacency.particleEnd.assign(adjacency.particleStart.begin(), adjacency.particleStart.end() - 1);
+	adjacency.constraints.resize(cloth.bendingConstraints.size());
+	for (size_t i = 0; i < cloth.bendingConstraints.size(); i++)
+	{
+		adjacency.constraints[adjacency.particleEnd[cloth.bendingConstraints[i].p1]++] = int(i);
+	}
+	adjacency.constraintsRevision = cloth.constraintsRevision;
+}
+
+// Keeps adjacency in sync with cloth.removeBendingConstraint(constraint), to be called before it
+inline void removeClothBendingAdjacencyConstraint(const Cloth& cloth, ClothBendingAdjacency& adjacency, int constraint)
+{
+	const int p1 = cloth.bendingConstraints[constraint].p1;
+	removeClothRowEntry(adjacency.constraints, adjacency.particleStart[p1], adjacency.particleEnd[p1], constraint);
+
+	const int last = int(cloth.bendingConstraints.size()) - 1;
+	if (last != constraint)
+	{
+		const int movedP1 = cloth.bendingConstraints[last].p1;
+		renameClothRowEntry(adjacency.constraints, adjacency.particleStart[movedP1], adjacency.particleEnd[movedP1], last, constraint);
+	}
+}
+
+// Compressed sparse row list of the triangles around each particle of a Cloth: triangles[particleStart[p]] to
+// triangles[particleEnd[p] - 1], as indices into Cloth::triangles
+struct ClothTriangleAdjacency
+{
+	std::vector<int> particleStart; // particleCount + 1 offsets into triangles
+	std::vector<int> particleEnd; // end of the entries still used in each row
+	std::vector<int> triangles;
+	unsigned int trianglesRevision = ~0u; // of the cloth triangles when built
+};
+
+inline void buildClothTriangleAdjacency(const Cloth& cloth, ClothTriangleAdjacency& adjacency)
+{
+	adjacency.particleStart.assign(cloth.particleCount() + 1, 0);
+	for (const glm::ivec3& triangle : cloth.triangles)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			adjacency.particleStart[triangle[i] + 1]++;
+		}
+	}
+	for (size_t p = 0; p < cloth.particleCount(); p++)
+	{
+		adjacency.particleStart[p + 1] += adjacency.particleStart[p];
+	}
+
+	std::vector<int> particleEnd(adjacency.particleStart.begin(), adjacency.particleStart.end() - 1);
+	adjacency.triangles.resize(3 * cloth.triangles.size());
+	for (size_t t = 0; t < cloth.triangles.size(); t++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			adjacency.triangles[particleEnd[cloth.triangles[t][i]]++] = int(t);
+		}
+	}
+	adjacency.particleEnd = std::move(particleEnd);
+	adjacency.trianglesRevision = cloth.trianglesRevision;
+}
+
+// Keeps adjacency in sync with cloth.removeTriangle(triangle), to be called before it
+inline void removeClothTriangleAdjacencyTriangle(const Cloth& cloth, ClothTriangleAdjacency& adjacency, int triangle)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		const int p = cloth.triangles[triangle][i];
+		removeClothRowEntry(adjacency.triangles, adjacency.particleStart[p], adjacency.particleEnd[p], triangle);
+	}
+
+	const int last = int(cloth.triangles.size()) - 1;
+	if (last != triangle)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			const int p = cloth.triangles[last][i];
+			renameClothRowEntry(adjacency.triangles, adjacency.particleStart[p], adjacency.particleEnd[p], last, triangle);
+		}
+	}
+}
+
+// Symmetric 3x3 block sparse matrix over the particles of a Cloth, in the compressed sparse rows of a ClothAdjacency:
+// row p holds diagonal[p], and offDiagonal[i] in the column columns[i] for i in [adjacency.particleStart[p], adjacency.particleEnd[p]).
+// Every constraint gives one block to the rows of both of its particles.
+struct ClothBlockMatrix
+{
+	std::vector<glm::mat3> diagonal;
+	std::vector<glm::mat3> offDiagonal;
+	std::vector<int> columns;
+
+	void resize(const ClothAdjacency& adjacency)
+	{
+		diagonal.resize(adjacency.particleStart.size() - 1);
+		offDiagonal.resize(adjacency.constraints.size());
+		columns.resize(adjacency.constraints.size());
+	}
+};
+
+// y = matrix * x for the rows in [begin, end)
+inline void multiplyClothBlockMatrix(const ClothBlockMatrix& matrix, const ClothAdjacency& adjacency, const glm::vec3* x, glm::vec3* y, size_t begin, size_t end)
+{
+	for (size_t p = begin; p < end; p++)
+	{
+		glm::vec3 product = matrix.diagonal[p] * x[p];
+		for (int i = adjacency.particleStart[p]; i < adjacency.particleEnd[p]; i++)
+		{
+			product += matrix.offDiagonal[i] * x[matrix.columns[i]];
+		}
+		y[p] = product;
+	}
+}
+
+// Particles of a Cloth are put to sleep by clusters: a cluster falls asleep once all of its particles
+// moved less than the sleep distance per step for SleepStepCount steps in a row. Sleeping particles are
+// not integrated and the constraints between two of them are not projected.
+struct ClothSleeping
+{
+	static constexpr int SleepStepCount = 30;
+
+	std::vector<int> particleClusters; // cluster of each particle
+	std::vector<int> clusterStart; // clusterCount + 1 offsets into clusterParticles
+	std::vector<int> clusterParticles; // particle indices sorted by cluster
+	std::vector<int> clusterQuietSteps; // consecutive steps an awake cluster stayed below the sleep distance
+	std::vector<uint8_t> clusterAsleep;
+	std::vector<uint8_t> particleAsleep; // clusterAsleep of the cluster of each particle, read by the solvers
+	int sleepingClusterCount = 0;
+
+	int clusterCount() const { return int(clusterStart.size()) - 1; }
+	bool allAsleep() const { return clusterCount() > 0 && sleepingClusterCount == clusterCount(); }
+
+	// True when every particle of the constraint is asleep
+	template <typename Constraint>
+	bool isAsleep(const Constraint& constraint) const
+	{
+		int particles[4];
+		const int particleCount = clothConstraintParticles(constraint, particles);
+		for (int i = 0; i < particleCount; i++)
+		{
+			if (!particleAsleep[particles[i]])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void setClusterAsleep(int cluster, bool asleep)
+	{
+		if (bool(clusterAsleep[cluster]) == asleep)
+		{
+			return;
+		}
+		clusterAsleep[cluster] = asleep;
+		clusterQuietSteps[cluster] = 0;
+		sleepingClusterCount += asleep ? 1 : -1;
+		for (int i = clusterStart[cluster]; i < clusterStart[cluster + 1]; i++)
+		{
+			particleAsleep[clusterParticles[i]] = asleep;
+		}
+	}
+
+	void wakeParticle(int particle)
+	{
+		setClusterAsleep(particleClusters[particle], false);
+	}
+
+	void wakeAll()
+	{
+		for (int cluster = 0; cluster < clusterCount(); cluster++)
+		{
+			setClusterAsleep(cluster, false);
+		}
+	}
+};
+
+// Every particle starts awake, particleClusters gives the cluster of each particle in [0, clusterCount)
+inline void initClothSleeping(ClothSleeping& sleeping, const std::vector<int>& particleClusters, int clusterCount)
+{
+	sleeping.particleClusters = particleClusters;
+	sleeping.clusterStart.assign(clusterCount + 1, 0);
+	for (int cluster : particleClusters)
+	{
+		sleeping.clusterStart[cluster + 1]++;
+	}
+	for (int cluster = 0; cluster < clusterCount; cluster++)
+	{
+		sleeping.clusterStart[cluster + 1] += sleeping.clusterStart[cluster];
+	}
+
+	std::vector<int> clusterEnd(sleeping.clusterStart.begin(), sleeping.clusterStart.end() - 1);
+	sleeping.clusterParticles.resize(particleClusters.size());
+	for (size_t p = 0; p < particleClusters.size(); p++)
+	{
+		sleeping.clusterParticles[clusterEnd[particleClusters[p]]++] = int(p);
+	}
+
+	sleeping.clusterQuietSteps.assign(clusterCount, 0);
+	sleeping.clusterAsleep.assign(clusterCount, 0);
+	sleeping.particleAsleep.assign(particleClusters.size(), 0);
+	sleeping.sleepingClusterCount = 0;
+}
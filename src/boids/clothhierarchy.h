@@ -0,0 +1,292 @@
+#pragma once
+
+#include "cloth.h"
+
+#include <glm/vec4.hpp>
+#include <vector>
+
+// Part of a hierarchy level lying on one grid of the cloth, its coarse particles are stored row by row from firstParticle
+struct ClothHierarchyGrid
+{
+	int firstParticle = 0; // in the particles of the level
+	std::vector<int> columns; // fine x coordinates of the coarse columns, empty when the grid is too small for the level
+	std::vector<int> rows; // fine y coordinates of the coarse rows
+};
+
+// Coarser version of the grid cloths: every step-th row and column of particles, the last ones included, linked
+// to their neighbors on the coarse grid. The coarse constraints only resist stretching, so that the fine level
+// can still wrinkle. The particles left out get the corrections of the coarse level by bilinear interpolation.
+// All the grids share the arrays of the level, so they are solved by the same colored passes.
+struct ClothHierarchyLevel
+{
+	int step = 1; // grid spacing of the level in fine particles
+	std::vector<ClothHierarchyGrid> grids; // one per grid of the cloth
+	std::vector<int> particles; // fine index of each coarse particle
+	std::vector<ClothConstraint> constraints; // between fine particle indices
+	std::vector<int> constraintEdges; // coarse grid edge of each constraint: 2 * coarse particle, + 1 for the edge to the next row
+	std::vector<int> edgeConstraints; // constraint of each coarse grid edge, -1 once cut
+
+	// Fine particles that are not on the level, with the 4 coarse particles (indices into particles) around them
+	std::vector<int> interpolatedParticles;
+	std::vector<glm::ivec4> interpolationParticles;
+	std::vector<glm::vec4> interpolationWeights; // all 0 once a cut crosses the coarse cell around the particle
+	std::vector<int> particleInterpolations; // index into interpolatedParticles of each fine particle, -1 when it is on the level
+	std::vector<bool> cutCells; // coarse cells whose interpolation is dropped, by their first corner
+
+	ClothConstraintColoring coloring;
+	bool coloringConflicts = false;
+	bool coloringOutdated = true;
+
+	std::vector<glm::vec3> startPositions; // of particles, before the level is solved
+};
+
+// Levels from the finest coarse level, step 2, to the coarsest one where a grid still has at least 3 rows and columns
+struct ClothHierarchy
+{
+	static constexpr int MaxLevelCount = 6;
+
+	std::vector<ClothGrid> grids; // of the cloth when the hierarchy was built
+	std::vector<ClothHierarchyLevel> levels;
+};
+
+// Index of coordinate in the coordinates of a level, -1 when it is not one of them
+inline int clothHierarchyIndex(const std::vector<int>& coordinates, int step, int coordinate)
+{
+	if (coordinate % step == 0)
+	{
+		return coordinate / step;
+	}
+	return coordinate == coordinates.back() ? int(coordinates.size()) - 1 : -1;
+}
+
+// Sorted coordinates multiple of step, and size - 1 so that the borders are kept
+inline std::vector<int> clothHierarchyCoordinates(int size, int step)
+{
+	std::vector<int> coordinates;
+	for (int i = 0; i < size; i += step)
+	{
+		coordinates.push_back(i);
+	}
+	if (coordinates.back() != size - 1)
+	{
+		coordinates.push_back(size - 1);
+	}
+	return coordinates;
+}
+
+// Index of the interval [coordinates[i], coordinates[i + 1]] holding coordinate, and its interpolation factor
+inline int clothHierarchyInterval(const std::vector<int>& coordinates, int coordinate, float& t)
+{
+	int i = 0;
+	while (i + 2 < int(coordinates.size()) && coordinates[i + 1] <= coordinate)
+	{
+		i++;
+	}
+	t = float(coordinate - coordinates[i]) / float(coordinates[i + 1] - coordinates[i]);
+	return i;
+}
+
+// Every grid of cloth gets its own coarse grid on each level it is large enough for
+inline void buildClothHierarchy(const Cloth& cloth, ClothHierarchy& hierarchy)
+{
+	hierarchy.grids = cloth.grids;
+	hierarchy.levels.clear();
+
+	for (int step = 2; int(hierarchy.levels.size()) < ClothHierarchy::MaxLevelCount; step *= 2)
+	{
+		ClothHierarchyLevel level;
+		level.step = step;
+		level.grids.resize(cloth.grids.size());
+		for (size_t g = 0; g < cloth.grids.size(); g++)
+		{
+			std::vector<int> columns = clothHierarchyCoordinates(cloth.grids[g].width, step);
+			std::vector<int> rows = clothHierarchyCoordinates(cloth.grids[g].height, step);
+			if (columns.size() >= 3 && rows.size() >= 3)
+			{
+				level.grids[g].columns = std::move(columns);
+				level.grids[g].rows = std::move(rows);
+			}
+		}
+		if (std::all_of(level.grids.begin(), level.grids.end(), [](const ClothHierarchyGrid& grid) { return grid.columns.empty(); }))
+		{
+			break;
+		}
+
+		std::vector<bool> onLevel(cloth.particleCount(), false);
+		level.particleInterpolations.assign(cloth.particleCount(), -1);
+		for (size_t g = 0; g < cloth.grids.size(); g++)
+		{
+			const ClothGrid& grid = cloth.grids[g];
+			ClothHierarchyGrid& levelGrid = level.grids[g];
+			levelGrid.firstParticle = int(level.particles.size());
+			for (int y : levelGrid.rows)
+			{
+				for (int x : levelGrid.columns)
+				{
+					level.particles.push_back(grid.particle(x, y));
+					onLevel[level.particles.back()] = true;
+				}
+			}
+		}
+
+		level.edgeConstraints.assign(2 * level.particles.size(), -1);
+		level.cutCells.assign(level.particles.size(), false);
+		const auto addConstraint = [&](int coarseParticle, int direction, int coarseOther) {
+			const int p1 = level.particles[coarseParticle];
+			const int p2 = level.particles[coarseOther];
+			const int edge = 2 * coarseParticle + direction;
+			level.edgeConstraints[edge] = int(level.constraints.size());
+			level.constraintEdges.push_back(edge);
+			level.constraints.push_back({ p1, p2, glm::distance(cloth.restPositions[p1], cloth.restPositions[p2]), 0.f, 0.f });
+		};
+		for (size_t g = 0; g < cloth.grids.size(); g++)
+		{
+			const ClothGrid& grid = cloth.grids[g];
+			const ClothHierarchyGrid& levelGrid = level.grids[g];
+			if (levelGrid.columns.empty())
+			{
+				continue; // its particles are left to the finer levels
+			}
+
+			const int first = levelGrid.firstParticle;
+			const int columnCount = int(levelGrid.columns.size());
+			const int rowCount = int(levelGrid.rows.size());
+			for (int j = 0; j < rowCount; j++)
+			{
+				for (int i = 0; i < columnCount; i++)
+				{
+					if (i < columnCount - 1) addConstraint(first + j * columnCount + i, 0, first + j * columnCount + i + 1);
+					if (j < rowCount - 1) addConstraint(first + j * columnCount + i, 1, first + (j + 1) * columnCount + i);
+				}
+			}
+
+			for (int y = 0; y < grid.height; y++)
+			{
+				float ty;
+				const int j = clothHierarchyInterval(levelGrid.rows, y, ty);
+				for (int x = 0; x < grid.width; x++)
+				{
+					if (onLevel[grid.particle(x, y)])
+					{
+						continue;
+					}
+					float tx;
+					const int i = clothHierarchyInterval(levelGrid.columns, x, tx);
+					const int corner = first + j * columnCount + i;
+					level.particleInterpolations[grid.particle(x, y)] = int(level.interpolatedParticles.size());
+					level.interpolatedParticles.push_back(grid.particle(x, y));
+					level.interpolationParticles.push_back(glm::ivec4(corner, corner + 1, corner + columnCount, corner + columnCount + 1));
+					level.interpolationWeights.push_back(glm::vec4((1.f - tx) * (1.f - ty), tx * (1.f - ty), (1.f - tx) * ty, tx * ty));
+				}
+			}
+		}
+		hierarchy.levels.push_back(std::move(level));
+	}
+}
+
+// Stops interpolating the corrections of the coarse cell (i, j) of a grid to the fine particles inside it, its corners
+// may lie on both sides of a cut. The particles are left to the fine constraints. Every cell is only dropped once.
+inline void dropClothHierarchyCell(ClothHierarchyLevel& level, const ClothGrid& grid, const ClothHierarchyGrid& levelGrid, int i, int j)
+{
+	const int corner = levelGrid.firstParticle + j * int(levelGrid.columns.size()) + i;
+	if (level.cutCells[corner])
+	{
+		return;
+	}
+	level.cutCells[corner] = true;
+	for (int y = levelGrid.rows[j]; y <= levelGrid.rows[j + 1]; y++)
+	{
+		for (int x = levelGrid.columns[i]; x <= levelGrid.columns[i + 1]; x++)
+		{
+			const int interpolation = level.particleInterpolations[grid.particle(x, y)];
+			if (interpolation >= 0)
+			{
+				level.interpolationWeights[interpolation] = glm::vec4(0.f);
+			}
+		}
+	}
+}
+
+// Removes the coarse constraints lying over the grid edge between the fine particles p1 and p2, so that a cut
+// in the fine cloth is not held together by the coarser levels. A fine edge lies under at most one constraint
+// per level, found from its coordinates, then swapped with the last constraint and popped. The coarse cells
+// holding the edge stop interpolating their corrections, which would drag the particles across the cut.
+inline void cutClothHierarchy(ClothHierarchy& hierarchy, int p1, int p2)
+{
+	const int g = clothGridOf(hierarchy.grids, p1);
+	if (g < 0)
+	{
+		return;
+	}
+	const ClothGrid& grid = hierarchy.grids[g];
+	const glm::ivec2 a = glm::ivec2((p1 - grid.firstParticle) % grid.width, (p1 - grid.firstParticle) / grid.width);
+	const glm::ivec2 b = glm::ivec2((p2 - grid.firstParticle) % grid.width, (p2 - grid.firstParticle) / grid.width);
+	const glm::ivec2 edgeMin = glm::min(a, b);
+	const bool alongRow = a.y == b.y;
+
+	for (ClothHierarchyLevel& level : hierarchy.levels)
+	{
+		const ClothHierarchyGrid& levelGrid = level.grids[g];
+		if (levelGrid.columns.empty())
+		{
+			continue;
+		}
+		const int columnCount = int(levelGrid.columns.size());
+		const int rowCount = int(levelGrid.rows.size());
+
+		// an edge on a coarse row or column lies in the cells on both of its sides
+		float t;
+		const int cellI = clothHierarchyInterval(levelGrid.columns, edgeMin.x, t);
+		const int cellJ = clothHierarchyInterval(levelGrid.rows, edgeMin.y, t);
+		for (int cj = glm::max(cellJ - 1, 0); cj <= glm::min(cellJ + 1, rowCount - 2); cj++)
+		{
+			for (int ci = glm::max(cellI - 1, 0); ci <= glm::min(cellI + 1, columnCount - 2); ci++)
+			{
+				const glm::ivec2 cellMin = glm::ivec2(levelGrid.columns[ci], levelGrid.rows[cj]);
+				const glm::ivec2 cellMax = glm::ivec2(levelGrid.columns[ci + 1], levelGrid.rows[cj + 1]);
+				if (glm::all(glm::lessThanEqual(cellMin, glm::min(a, b))) && glm::all(glm::lessThanEqual(glm::max(a, b), cellMax)))
+				{
+					dropClothHierarchyCell(level, grid, levelGrid, ci, cj);
+				}
+			}
+		}
+
+		int i, j;
+		if (alongRow)
+		{
+			j = clothHierarchyIndex(levelGrid.rows, level.step, edgeMin.y);
+			i = glm::min(edgeMin.x / level.step, columnCount - 2);
+		}
+		else
+		{
+			i = clothHierarchyIndex(levelGrid.columns, level.step, edgeMin.x);
+			j = glm::min(edgeMin.y / level.step, rowCount - 2);
+		}
+		if (i < 0 || j < 0)
+		{
+			continue; // the edge is between two coarse rows or columns
+		}
+
+		const int edge = 2 * (levelGrid.firstParticle + j * columnCount + i) + (alongRow ? 0 : 1);
+		const int constraint = level.edgeConstraints[edge];
+		if (constraint < 0)
+		{
+			continue;
+		}
+
+		const int last = int(level.constraints.size()) - 1;
+		if (!level.coloringOutdated)
+		{
+			removeClothColoredConstraint(level.coloring, constraint, last);
+		}
+		level.edgeConstraints[edge] = -1;
+		level.constraints[constraint] = level.constraints[last];
+		level.constraintEdges[constraint] = level.constraintEdges[last];
+		if (last != constraint)
+		{
+			level.edgeConstraints[level.constraintEdges[constraint]] = constraint;
+		}
+		level.constraints.pop_back();
+		level.constraintEdges.pop_back();
+	}
+}
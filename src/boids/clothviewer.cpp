@@ -1,6 +1,13 @@
 #include "../viewer.h"
 #include "../drawbuffer.h"
 #include "../renderapi.h"
+#include "../threadpool.h"
+#include "spatialgrid.h"
+#include "cloth.h"
+#include "clothhierarchy.h"
+#include "colliders.h"
+#include "meshcollider.h"
+#include "wind.h"
 
 #include <random>
 #include <time.h>
@@ -12,220 +19,1685 @@
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <iostream>
+#include <chrono>
+#include <atomic>
 
 #define COUNTOF(ARRAY) (sizeof(ARRAY) / sizeof(ARRAY[0]))
-#define CONSTRAINT_ITERATIONS 15 // how many iterations of constraint satisfaction each frame (more is rigid, less is soft)
+#define CONSTRAINT_ITERATIONS 4 // default number of iterations of constraint satisfaction each substep (more is rigid, less is soft), the tethers keep the cloth from stretching with few of them
 #define DAMPING 0.01f // how much to damp the cloth simulation each frame
-#define TIME_STEPSIZE2 0.5f*0.5f // how large time step each particle takes each frame
+#define TIME_STEPSIZE 0.5f // how large time step each particle takes each frame
+#define TIME_STEPSIZE2 TIME_STEPSIZE*TIME_STEPSIZE
 
 constexpr char const* clothViewerName = "ClothViewer";
 
-class ClothParticle 
+enum class eClothIntegrator : int {
+	Verlet = 0, // explicit Verlet integration followed by the constraint projections
+	ImplicitEuler, // backward Euler on the constraints seen as springs [Baraff and Witkin 1998], solved with a preconditioned conjugate gradient
+};
+
+enum class eClothSolver : int {
+	Sequential = 0, // Gauss-Seidel in constraint order on the calling thread
+	GraphColored, // Gauss-Seidel color by color, the constraints of a color are solved in parallel
+	Jacobi, // every particle gathers the corrections of its constraints from the previous iterate, in parallel
+};
+
+struct ClothVertexShaderAdditionalData
+{
+	glm::vec3 Pos;
+	/// beware of alignement (std430 rule)
+};
+
+struct ClothViewer : Viewer
 {
-public:
-	bool CanMove;
-	glm::vec3 Position;
-	glm::vec3 OldPosition;
-	glm::vec3 Velocity;
-	float Mass = 1; // the mass of the particle (is always 1 in this example)
+	glm::vec2 mousePos;
 
-	ClothParticle(glm::vec3 position) : Position(position), CanMove(true), OldPosition(position), Velocity(glm::vec3(0, 0, 0)) { }
+	bool leftMouseButtonPressed;
+	bool altKeyPressed;
+
+	// Tweakable data
+	int clothWidth = 10;
+	int clothHeight = 10;
+	float width = 5;
+	float height = 5;
+	// Independent cloths of clothWidth x clothHeight particles, packed in the arrays of cloth so that every solver pass
+	// handles all of them at once. They share the width x height rectangle, each one a row further back.
+	int clothCount = 1;
+	glm::vec2 particleSpacing = glm::vec2(0.5f); // within every grid, in rest configuration
+
+	glm::vec3 windForce = glm::vec3(0, 0, 0);
+	glm::vec3 gravity = glm::vec3(0, 0, 0);
 
-	void offsetPos(const glm::vec3 v) { if (CanMove) Position += v; }
+	float oldElapsedTime;
 
-	void makeUnmovable() { CanMove = false; }
-	void resetAcceleration() { Velocity = glm::vec3(0, 0, 0); }
+	// Aerodynamics, each triangle is pushed along its normal by the air crossing it: windForce plus a turbulence sampled from
+	// a noise field baked on a coarse grid around the cloth, which drifts with the wind
+	bool aerodynamics = true;
+	float dragCoefficient = 1.f; // the same force per unit of mass whatever the cloth resolution
+	float turbulence = 0.5f; // relative to the wind speed
+	float turbulenceFrequency = 0.5f; // of the noise, per unit of length
+	int windFieldResolution = 8; // samples per side, the noise is evaluated windFieldResolution^3 times per frame
+	WindField windField;
+	glm::vec3 windFieldOffset = glm::vec3(0.f);
+	eSimdLevel windSimdLevel = eSimdLevel::Scalar; // at most detectSimdLevel()
+	std::vector<float> triangleForcesX; // aerodynamic force on each triangle
+	std::vector<float> triangleForcesY;
+	std::vector<float> triangleForcesZ;
+	std::vector<glm::vec3> aerodynamicAccelerations; // of each particle, from the last applyAerodynamicForces
+	std::vector<glm::vec3> sleepAerodynamicAccelerations; // aerodynamicAccelerations of each particle when its cluster fell asleep
+	std::vector<uint8_t> clusterWindChanged;
+	float aerodynamicsDurationMs = 0.f;
+	float windSimdDifference = -1.f; // largest force difference with the scalar path, negative until compared
+	float windSimdMaxForce = 0.f; // largest force of the comparison, to scale the difference
+	float stepDurationMs = 0.f; // of the last timeStep, to compare the aerodynamics with
 
-	void addForce(glm::vec3 f)
+	// Self collision, particles are kept at least thickness apart
+	bool selfCollision = true;
+	float thickness = 0.05f;
+	SpatialGrid collisionGrid;
+	std::vector<int> collisionCandidates;
+	std::vector<glm::ivec2> collisionPairs; // particles closer than thickness + skin when the pairs were found
+	std::vector<glm::vec3> collisionPairsPositions; // particle positions when the pairs were found
+	float collisionPairsThickness = 0.f;
+	int collisionPairsRebuildCount = 0;
+	float collisionDurationMs = 0.f;
+
+	// Colliders, the particles are pushed out of them after the constraints of every iteration
+	bool collisions = true;
+	ColliderSet colliders;
+	float colliderThickness = 0.05f; // distance kept between the particles and the colliders
+	eSimdLevel colliderSimdLevel = eSimdLevel::Scalar; // at most detectSimdLevel()
+	float colliderDurationMs = 0.f;
+	float colliderSimdDifference = -1.f; // largest coordinate difference with the scalar path, negative until compared
+
+	// Triangle mesh collider, its hierarchy is built when the resolution changes and refit while the mesh animates
+	bool meshCollisions = true;
+	MeshCollider meshCollider;
+	int meshResolution = 64; // quads per side, 2 triangles each
+	int meshColliderResolution = 0; // of meshCollider
+	glm::vec3 meshCenter = glm::vec3(2.5f, -5.f, 0.f);
+	float meshSize = 8.f;
+	float meshAmplitude = 0.4f;
+	bool animateMesh = false;
+	float meshTime = 0.f;
+	std::vector<glm::vec3> meshNormals;
+	IndexBuffer3D meshIndices;
+	size_t meshIndicesTriangleCount = 0; // of meshIndices
+	float meshBuildDurationMs = 0.f;
+	float meshRefitDurationMs = 0.f;
+	size_t meshQueryCount = 0; // particles tested against the mesh during the last timeStep
+	float meshQueryDurationMs = 0.f;
+	double benchmarkQueriesPerSecond = 0.0;
+	double benchmarkTrianglesPerQuery = 0.0;
+
+	// Solver
+	eClothSolver solver = eClothSolver::GraphColored;
+	int iterationCount = CONSTRAINT_ITERATIONS;
+	int substepCount = 1; // TIME_STEPSIZE is split in substepCount integrations, each one followed by iterationCount iterations
+	int integratedSubstepCount = 1; // substep count of the last timeStep, to rescale the velocities when it changes
+	bool xpbd = false; // the constraints are solved with their compliance, the stiffness then no longer depends on iterationCount or substepCount
+	float stretchCompliance = 0.f;
+	bool tethers = true; // particles stay within their rest distance of the pinned particles
+	bool bending = true; // always solved with XPBD, color by color whatever the solver
+	float bendingCompliance = 1.f;
+	ClothBendingColoring bendingColoring;
+	bool bendingColoringConflicts = false;
+	float maxStretch = 0.f; // largest relative elongation of a stretch constraint after the last timeStep
+	int workerCount = 0;
+	ThreadPool threadPool;
+	ClothConstraintColoring coloring;
+	bool coloringConflicts = false; // more than MaxColorCount colors were needed, the last color is solved sequentially
+	std::vector<float> colorDurationsMs; // summed over the iterations of the last timeStep
+	ClothAdjacency adjacency;
+	std::vector<glm::vec3> jacobiPositions; // iterate written by the Jacobi solver, then swapped with cloth.positions
+	float jacobiOverRelaxation = 1.5f; // 1 is plain averaging, up to 2 speeds up the convergence
+	float solveDurationMs = 0.f;
+
+	// Rendering, the cloth is one indexed mesh whose positions and normals are streamed every frame
+	bool drawClothMesh = true;
+	bool drawWireframe = false; // the constraints over the mesh
+	bool drawParticles = false; // sleeping particles are drawn in blue
+	ClothTriangleAdjacency triangleAdjacency;
+	std::vector<glm::vec3> faceNormals; // area weighted normal of each triangle
+	std::vector<glm::vec3> normals; // of each particle
+	IndexBuffer3D triangleIndices;
+	IndexBuffer3D edgeIndices; // a line for each constraint
+	unsigned int triangleIndicesRevision = ~0u; // cloth.trianglesRevision when triangleIndices was built
+	unsigned int edgeIndicesRevision = ~0u; // cloth.constraintsRevision when edgeIndices was built
+
+	// Tearing, a stretch constraint breaks once its relative elongation passes tearStrain. The constraint, the triangles
+	// on its edge and their bending constraints are removed in O(1), the data derived from them is updated in place.
+	bool tearing = false;
+	float tearStrain = 0.5f;
+	ClothBendingAdjacency bendingAdjacency; // to find the bending constraints across a removed triangle
+	std::vector<std::vector<int>> taskTornConstraints; // one per parallelFor range of the strain test
+	std::vector<int> tornGrids; // grids torn since their tethers were last detached, -1 for a cloth without grids
+	ClothTetherScratch tetherScratch;
+	std::mt19937 randomEngine;
+	int tornConstraintCount = 0; // during the last timeStep
+	float tearDurationMs = 0.f;
+
+	// Hierarchy, the coarse levels of the grid are solved from the coarsest one before the constraints of every substep
+	ClothHierarchy hierarchy;
+	int hierarchyLevelCount = 0; // coarse levels used, 0 only solves the cloth itself
+	int hierarchyIterations = 2; // per level and substep
+	float hierarchyDurationMs = 0.f;
+
+	// Implicit integration, one step of TIME_STEPSIZE per frame whatever the substep count
+	eClothIntegrator integrator = eClothIntegrator::Verlet;
+	float springStiffness = 5000.f; // far stiffer than Verlet integration can handle at TIME_STEPSIZE
+	float springDamping = 1.f;
+	int maxCgIterations = 200;
+	float cgTolerance = 1e-4f; // of the residual norm relative to the right hand side norm
+	ClothBlockMatrix implicitMatrix; // M - h * df/dv - h^2 * df/dx
+	std::vector<glm::mat3> implicitPreconditioner; // inverses of the diagonal blocks of implicitMatrix
+	std::vector<glm::vec3> implicitVelocities;
+	std::vector<glm::vec3> implicitRhs; // h * (f + h * df/dx * v)
+	std::vector<glm::vec3> cgDeltaVelocities; // solution of the system
+	std::vector<glm::vec3> cgResidual;
+	std::vector<glm::vec3> cgPreconditioned;
+	std::vector<glm::vec3> cgDirection;
+	std::vector<glm::vec3> cgProduct;
+	std::vector<float> taskSums; // one per parallelFor range of a dot product
+	int cgIterationCount = 0;
+	float cgRelativeResidual = 0.f;
+	float assemblyDurationMs = 0.f;
+
+	// Convergence, the iterations of a substep stop once the sweep measured a small enough error
+	static constexpr int IterationHistorySize = 120;
+	bool earlyExit = true;
+	float errorTolerance = 1e-3f; // largest relative constraint error |C| / restDistance accepted to stop iterating
+	std::vector<ClothResidual> taskResiduals; // one per parallelFor range of the current sweep
+	std::vector<float> iterationMaxErrors; // every iteration of the last timeStep, substep after substep
+	std::vector<float> iterationRmsErrors;
+	int solvedIterationCount = 0; // over all the substeps of the last timeStep
+	float iterationHistory[IterationHistorySize] = {}; // solvedIterationCount of the last frames, ring buffer
+	int iterationHistoryOffset = 0;
+
+	// Sleeping, the particles of a SleepClusterSize x SleepClusterSize tile of the grid sleep together
+	static constexpr int SleepClusterSize = 8;
+	bool sleepingEnabled = true;
+	float sleepDistance = 1e-3f; // a cluster falls asleep when its particles move less than this per substep, and wakes up above twice this
+	ClothSleeping sleeping;
+	std::vector<float> clusterMovesSqr; // largest squared move of the particles of each cluster during the last substep
+	glm::vec3 lastExternalAcceleration = glm::vec3(0.f);
+
+	Cloth cloth;
+
+	int getParticle(int grid, int x, int y) const { return cloth.grids[grid].particle(x, y); }
+	void makeConstraint(int p1, int p2) { cloth.addConstraint(p1, p2, stretchCompliance); }
+	void makeQuad(int p00, int p10, int p11, int p01)
 	{
-		Velocity += f / Mass;
+		cloth.addTriangle(p00, p10, p11);
+		cloth.addTriangle(p00, p11, p01);
 	}
 
-	// This is one of the important methods, where the time is progressed a single step size (TIME_STEPSIZE)
-	// The method is called by Cloth.time_step()
-	// Given the equation "force = mass * acceleration" the next position is found through verlet integration
-	void timeStep()
+	ClothViewer() : Viewer(clothViewerName, 1280, 720) {}
+
+	~ClothViewer() { deleteThreadPool(threadPool); }
+
+	static float distance(glm::vec3 position1, glm::vec3 position2) {
+		float xSqr = (position1.x - position2.x) * (position1.x - position2.x);
+		float ySqr = (position1.y - position2.y) * (position1.y - position2.y);
+		float zSqr = (position1.z - position2.z) * (position1.z - position2.z);
+
+		float sqr = xSqr + ySqr + zSqr;
+
+		return sqrt(sqr);
+	}
+
+	void deleteRandomConstraint() 
 	{
-		if (CanMove)
+		if (!cloth.constraints.empty())
 		{
-			glm::vec3 temp = Position;
-			Position = Position + (Position - OldPosition) * (1.0f - DAMPING) + Velocity * TIME_STEPSIZE2;
-			OldPosition = temp;
-			Velocity = glm::vec3(0, 0, 0); // acceleration is reset since it HAS been translated into a change in position (and implicitely into velocity)	
+			std::uniform_int_distribution<int> constraintDistribution(0, int(cloth.constraints.size()) - 1);
+			tearConstraint(constraintDistribution(randomEngine));
+			detachTornTethers();
 		}
 	}
 
-	void updateDerivatives(float dt)
+	void removeTriangle(int triangle)
 	{
-		Velocity = (Position - OldPosition) / dt;
+		// the bending constraints across the edges of the triangle lose one of their two triangles
+		const glm::ivec3 particles = cloth.triangles[triangle];
+		for (int i = 0; i < 3; i++)
+		{
+			removeBendingConstraint(particles[i], particles[(i + 1) % 3]);
+		}
+
+		const int last = int(cloth.triangles.size()) - 1;
+		if (triangleIndicesRevision == cloth.trianglesRevision)
+		{
+			if (last != triangle)
+			{
+				updateIndexBuffer3D(triangleIndices, 3 * triangle, (unsigned int const*)&cloth.triangles[last], 3);
+			}
+			triangleIndices.indexCount -= 3;
+		}
+		removeClothTriangleAdjacencyTriangle(cloth, triangleAdjacency, triangle);
+		cloth.removeTriangle(triangle);
 	}
-};
 
-class Constraint
-{
-private:
-	float restDistance; // the length between particle p1 and p2 in rest configuration
-	float strength;
+	// Removes the bending constraint hinged on the edge between p1 and p2, if any
+	void removeBendingConstraint(int p1, int p2)
+	{
+		const int hinge1 = glm::min(p1, p2);
+		const int hinge2 = glm::max(p1, p2);
+		for (int i = bendingAdjacency.particleStart[hinge1]; i < bendingAdjacency.particleEnd[hinge1]; i++)
+		{
+			const int constraint = bendingAdjacency.constraints[i];
+			if (cloth.bendingConstraints[constraint].p2 == hinge2)
+			{
+				if (bendingColoring.constraintsRevision == cloth.constraintsRevision)
+				{
+					removeClothColoredConstraint(bendingColoring, constraint, int(cloth.bendingConstraints.size()) - 1);
+				}
+				removeClothBendingAdjacencyConstraint(cloth, bendingAdjacency, constraint);
+				cloth.removeBendingConstraint(constraint);
+				return;
+			}
+		}
+	}
+
+	// Removes a stretch constraint with the triangles on its edge, and the bending constraints across those triangles.
+	// The structures derived from the cloth that are up to date are updated in place, the outdated ones are rebuilt anyway.
+	void tearConstraint(int constraint)
+	{
+		if (triangleAdjacency.trianglesRevision != cloth.trianglesRevision)
+		{
+			buildClothTriangleAdjacency(cloth, triangleAdjacency);
+		}
+		if (bendingAdjacency.constraintsRevision != cloth.constraintsRevision)
+		{
+			buildClothBendingAdjacency(cloth, bendingAdjacency);
+		}
+		if (adjacency.constraintsRevision != cloth.constraintsRevision)
+		{
+			buildClothAdjacency(cloth, adjacency);
+		}
+
+		const ClothConstraint torn = cloth.constraints[constraint];
+		sleeping.wakeParticle(torn.p1);
+		sleeping.wakeParticle(torn.p2);
+		cutClothHierarchy(hierarchy, torn.p1, torn.p2);
+
+		const int last = int(cloth.constraints.size()) - 1;
+		if (coloring.constraintsRevision == cloth.constraintsRevision)
+		{
+			removeClothColoredConstraint(coloring, constraint, last);
+		}
+		removeClothAdjacencyConstraint(cloth, adjacency, constraint);
+		if (edgeIndicesRevision == cloth.constraintsRevision)
+		{
+			if (last != constraint)
+			{
+				const unsigned int moved[2] = { (unsigned int)cloth.constraints[last].p1, (unsigned int)cloth.constraints[last].p2 };
+				updateIndexBuffer3D(edgeIndices, 2 * constraint, moved, 2);
+			}
+			edgeIndices.indexCount -= 2;
+		}
+		cloth.removeConstraint(constraint);
+		// only the grid of the torn constraint can lose tethers, they are detached after the whole batch of tears
+		const int grid = clothGridOf(cloth.grids, torn.p1);
+		if (cloth.tetherCount() > 0 && (grid >= 0 || cloth.grids.empty()))
+		{
+			tornGrids.push_back(grid);
+		}
+
+		// every removal puts another triangle of the row at i
+		for (int i = triangleAdjacency.particleStart[torn.p1]; i < triangleAdjacency.particleEnd[torn.p1]; )
+		{
+			const int triangle = triangleAdjacency.triangles[i];
+			const glm::ivec3 particles = cloth.triangles[triangle];
+			if (particles.x == torn.p2 || particles.y == torn.p2 || particles.z == torn.p2)
+			{
+				removeTriangle(triangle);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	// Once per batch of tearConstraint calls, the grids torn by several of them are only flood filled once
+	void detachTornTethers()
+	{
+		std::sort(tornGrids.begin(), tornGrids.end());
+		tornGrids.erase(std::unique(tornGrids.begin(), tornGrids.end()), tornGrids.end());
+		detachClothTethers(cloth, adjacency, tornGrids, tetherScratch);
+		tornGrids.clear();
+	}
+
+	// The strain of every constraint is tested in parallel, then the broken ones are torn sequentially
+	void tearOverstretchedConstraints()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		constexpr size_t constraintsPerTask = 4096;
+		const size_t taskCount = (cloth.constraints.size() + constraintsPerTask - 1) / constraintsPerTask;
+		if (taskTornConstraints.size() < taskCount)
+		{
+			taskTornConstraints.resize(taskCount);
+		}
+		const float maxDistanceFactor = 1.f + tearStrain;
+		parallelFor(threadPool, cloth.constraints.size(), constraintsPerTask, [&](size_t begin, size_t end) {
+			std::vector<int>& torn = taskTornConstraints[begin / constraintsPerTask];
+			torn.clear();
+			for (size_t i = begin; i < end; i++)
+			{
+				const ClothConstraint& constraint = cloth.constraints[i];
+				const glm::vec3 delta = cloth.positions[constraint.p2] - cloth.positions[constraint.p1];
+				const float maxDistance = maxDistanceFactor * constraint.restDistance;
+				if (glm::dot(delta, delta) > maxDistance * maxDistance)
+				{
+					torn.push_back(int(i));
+				}
+			}
+		});
+
+		// from the last one, so that the constraint swapped in by every removal has already been tested
+		for (size_t task = taskCount; task-- > 0; )
+		{
+			const std::vector<int>& torn = taskTornConstraints[task];
+			for (size_t i = torn.size(); i-- > 0; )
+			{
+				tearConstraint(torn[i]);
+				tornConstraintCount++;
+			}
+		}
+		detachTornTethers();
+
+		tearDurationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
 
-public:
-	ClothParticle* p1, * p2; // the two particles that are connected through this constraint
+	// The pairs are searched up to thickness + skin, so they stay valid until a particle moves by more
+	// than half the skin. Half of that margin is kept for the motion during the step itself.
+	float collisionSkin() const { return 0.5f * thickness; }
 
-	Constraint(ClothParticle* p1, ClothParticle* p2) : p1(p1), p2(p2)
+	bool collisionPairsOutdated() const
 	{
-		restDistance = distance(p1->Position, p2->Position);
+		if (collisionPairsPositions.size() != cloth.particleCount() || collisionPairsThickness != thickness)
+		{
+			return true;
+		}
+
+		const float maxMove = 0.25f * collisionSkin();
+		const float maxMoveSqr = maxMove * maxMove;
+		for (size_t i = 0; i < cloth.particleCount(); i++)
+		{
+			const glm::vec3 move = cloth.positions[i] - collisionPairsPositions[i];
+			if (glm::dot(move, move) > maxMoveSqr)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Rebuilds the spatial hash and pairs the particles that can touch before the next rebuild,
+	// the constraint iterations only test these pairs
+	void findCollisionPairs()
+	{
+		collisionPairs.clear();
+		collisionPairsPositions = cloth.positions;
+		collisionPairsThickness = thickness;
+		collisionPairsRebuildCount++;
+
+		const float queryRadius = thickness + collisionSkin();
+		const float queryRadiusSqr = queryRadius * queryRadius;
+		const float thicknessSqr = thickness * thickness;
+		collisionGrid.build(cloth.particleCount(), queryRadius, [&](size_t i) { return cloth.positions[i]; });
+
+		for (size_t i = 0; i < cloth.particleCount(); i++)
+		{
+			collisionCandidates.clear();
+			collisionGrid.gather(cloth.positions[i], queryRadius, collisionCandidates);
+			for (int j : collisionCandidates)
+			{
+				if (j <= int(i))
+				{
+					continue;
+				}
+				// particles closer than thickness at rest would fight against the constraints
+				const glm::vec3 restOffset = cloth.restPositions[j] - cloth.restPositions[i];
+				if (glm::dot(restOffset, restOffset) < thicknessSqr)
+				{
+					continue;
+				}
+				const glm::vec3 offset = cloth.positions[j] - cloth.positions[i];
+				if (glm::dot(offset, offset) < queryRadiusSqr)
+				{
+					collisionPairs.push_back(glm::ivec2(int(i), j));
+				}
+			}
+		}
+	}
+
+	// Moves both particles along p1_to_p2 so that their distance changes by distanceError,
+	// each one proportionally to its inverse mass
+	void moveParticles(int p1, int p2, const glm::vec3& p1_to_p2, float distanceError)
+	{
+		const float w1 = cloth.inverseMasses[p1];
+		const float w2 = cloth.inverseMasses[p2];
+		const float wSum = w1 + w2;
+		if (wSum == 0.f)
+		{
+			return;
+		}
+		const glm::vec3 correctionVector = p1_to_p2 * (distanceError / wSum);
+		cloth.positions[p1] += correctionVector * w1;
+		cloth.positions[p2] -= correctionVector * w2;
+	}
+
+	static float relativeError(const ClothConstraint& constraint, float error)
+	{
+		return constraint.restDistance > 0.f ? fabsf(error) / constraint.restDistance : fabsf(error);
 	}
 
 	/* This is one of the important methods, where a single constraint between two particles p1 and p2 is solved
-	the method is called by Cloth.time_step() many times per frame*/
-	void satisfyConstraint()
+	the method is called by timeStep() many times per frame. Returns the relative error before the projection */
+	float satisfyConstraint(const ClothConstraint& constraint)
 	{
-		glm::vec3 p1_to_p2 = p2->Position - p1->Position; // vector from p1 to p2
-		float current_distance = distance(p1->Position, p2->Position); // current distance between p1 and p2
-		glm::vec3 correctionVector = p1_to_p2 * (1 - restDistance / current_distance); // The offset vector that could moves p1 into a distance of rest_distance to p2
-		glm::vec3 correctionVectorHalf = glm::vec3(correctionVector.x * 0.5, correctionVector.y * 0.5, correctionVector.z * 0.5); // Lets make it half that length, so that we can move BOTH p1 and p2.
-		p1->offsetPos(correctionVectorHalf); // correctionVectorHalf is pointing from p1 to p2, so the length should move p1 half the length needed to satisfy the constraint.
-		p2->offsetPos(-correctionVectorHalf); // we must move p2 the negative direction of correctionVectorHalf since it points from p2 to p1, and not p1 to p2.	
+		const glm::vec3 p1_to_p2 = cloth.positions[constraint.p2] - cloth.positions[constraint.p1]; // vector from p1 to p2
+		const float current_distance = glm::length(p1_to_p2); // current distance between p1 and p2
+		if (current_distance == 0.f)
+		{
+			return 0.f;
+		}
+		// p1 and p2 are moved towards each other until they are restDistance apart
+		moveParticles(constraint.p1, constraint.p2, p1_to_p2 / current_distance, current_distance - constraint.restDistance);
+		return relativeError(constraint, current_distance - constraint.restDistance);
 	}
-};
 
-struct ClothVertexShaderAdditionalData
-{
-	glm::vec3 Pos;
-	/// beware of alignement (std430 rule)
-};
+	// Only pulls p1 and p2 together, returns the relative error before the projection
+	float satisfyStretchConstraint(const ClothConstraint& constraint)
+	{
+		const glm::vec3 p1_to_p2 = cloth.positions[constraint.p2] - cloth.positions[constraint.p1];
+		const float current_distance = glm::length(p1_to_p2);
+		if (current_distance <= constraint.restDistance)
+		{
+			return 0.f;
+		}
+		moveParticles(constraint.p1, constraint.p2, p1_to_p2 / current_distance, current_distance - constraint.restDistance);
+		return relativeError(constraint, current_distance - constraint.restDistance);
+	}
+
+	// XPBD projection of a single constraint, alphaTilde is its compliance divided by the squared substep.
+	// Returns the relative residual C + alphaTilde * lambda before the projection, which goes to 0 even for a compliant constraint.
+	float satisfyConstraintXpbd(ClothConstraint& constraint, float invSubstepSize2)
+	{
+		const glm::vec3 p1_to_p2 = cloth.positions[constraint.p2] - cloth.positions[constraint.p1];
+		const float current_distance = glm::length(p1_to_p2);
+		const float w1 = cloth.inverseMasses[constraint.p1];
+		const float w2 = cloth.inverseMasses[constraint.p2];
+		if (current_distance == 0.f || w1 + w2 == 0.f)
+		{
+			return 0.f;
+		}
+
+		const float alphaTilde = constraint.compliance * invSubstepSize2;
+		const float C = current_distance - constraint.restDistance;
+		const float residual = C + alphaTilde * constraint.lambda;
+		const float deltaLambda = -residual / (w1 + w2 + alphaTilde);
+		constraint.lambda += deltaLambda;
+
+		// the gradient of C is -direction for p1 and direction for p2
+		const glm::vec3 direction = p1_to_p2 / current_distance;
+		cloth.positions[constraint.p1] -= direction * (w1 * deltaLambda);
+		cloth.positions[constraint.p2] += direction * (w2 * deltaLambda);
+		return relativeError(constraint, residual);
+	}
+
+	// XPBD projection of the signed dihedral angle of clothDihedralAngle. Its gradients [Bridson et al. 2003, Simulation of
+	// Clothing with Folds and Wrinkles] are the normals of the triangles scaled by the inverse of their heights over the edge,
+	// so they stay well defined at flat. Returns nothing useful for the residual, whose unit is a length ratio.
+	void satisfyBendingConstraint(ClothBendingConstraint& constraint, float invSubstepSize2)
+	{
+		const glm::vec3 x1 = cloth.positions[constraint.p1];
+		const glm::vec3 x2 = cloth.positions[constraint.p2];
+		const glm::vec3 x3 = cloth.positions[constraint.p3];
+		const glm::vec3 x4 = cloth.positions[constraint.p4];
+		const glm::vec3 edge = x2 - x1;
+		const glm::vec3 n1 = glm::cross(edge, x3 - x1);
+		const glm::vec3 n2 = glm::cross(x4 - x1, edge);
+		const float edgeLength = glm::length(edge);
+		const float n1LengthSqr = glm::dot(n1, n1);
+		const float n2LengthSqr = glm::dot(n2, n2);
+		if (edgeLength < 1e-6f || n1LengthSqr < 1e-12f || n2LengthSqr < 1e-12f) // degenerate triangles
+		{
+			return;
+		}
+
+		const glm::vec3 m1 = n1 / n1LengthSqr;
+		const glm::vec3 m2 = n2 / n2LengthSqr;
+		const float invEdgeLength = 1.f / edgeLength;
+		const glm::vec3 q3 = m1 * edgeLength;
+		const glm::vec3 q4 = m2 * edgeLength;
+		const glm::vec3 q1 = m1 * (glm::dot(x3 - x2, edge) * invEdgeLength) + m2 * (glm::dot(x4 - x2, edge) * invEdgeLength);
+		const glm::vec3 q2 = -q1 - q3 - q4;
+
+		const float w1 = cloth.inverseMasses[constraint.p1];
+		const float w2 = cloth.inverseMasses[constraint.p2];
+		const float w3 = cloth.inverseMasses[constraint.p3];
+		const float w4 = cloth.inverseMasses[constraint.p4];
+		const float wSum = w1 * glm::dot(q1, q1) + w2 * glm::dot(q2, q2) + w3 * glm::dot(q3, q3) + w4 * glm::dot(q4, q4);
+		if (wSum == 0.f)
+		{
+			return;
+		}
+
+		const float angle = atan2f(glm::dot(glm::cross(n2, n1), edge) * invEdgeLength, glm::dot(n1, n2));
+		float C = angle - constraint.restAngle;
+		// the shortest way around, the angles are in [-pi, pi]
+		if (C > glm::pi<float>())
+		{
+			C -= glm::two_pi<float>();
+		}
+		else if (C < -glm::pi<float>())
+		{
+			C += glm::two_pi<float>();
+		}
+
+		const float alphaTilde = constraint.compliance * invSubstepSize2;
+		const float deltaLambda = (-C - alphaTilde * constraint.lambda) / (wSum + alphaTilde);
+		constraint.lambda += deltaLambda;
+
+		cloth.positions[constraint.p1] += q1 * (w1 * deltaLambda);
+		cloth.positions[constraint.p2] += q2 * (w2 * deltaLambda);
+		cloth.positions[constraint.p3] += q3 * (w3 * deltaLambda);
+		cloth.positions[constraint.p4] += q4 * (w4 * deltaLambda);
+	}
+
+	// Tethers only pull a particle back when it gets further than their length from its anchor, the anchor is pinned
+	// so every particle only moves itself and they are all solved in parallel
+	ClothResidual satisfyTethers()
+	{
+		constexpr size_t particlesPerTask = 1024;
+		resetTaskResiduals(cloth.particleCount(), particlesPerTask);
+		parallelFor(threadPool, cloth.particleCount(), particlesPerTask, [&](size_t begin, size_t end) {
+			ClothResidual rangeResidual;
+			for (size_t p = begin; p < end; p++)
+			{
+				if (sleeping.particleAsleep[p])
+				{
+					continue;
+				}
+				for (int i = cloth.tetherStart[p]; i < cloth.tetherStart[p + 1]; i++)
+				{
+					const glm::vec3 anchor = cloth.positions[cloth.tetherAnchors[i]];
+					const glm::vec3 anchor_to_p = cloth.positions[p] - anchor;
+					const float current_distance = glm::length(anchor_to_p);
+					const float tetherDistance = cloth.tetherDistances[i];
+					if (current_distance > tetherDistance)
+					{
+						cloth.positions[p] = anchor + anchor_to_p * (tetherDistance / current_distance);
+						rangeResidual.add((current_distance - tetherDistance) / tetherDistance);
+					}
+				}
+			}
+			taskResiduals[begin / particlesPerTask].merge(rangeResidual);
+		});
+
+		ClothResidual residual;
+		mergeTaskResiduals(residual);
+		return residual;
+	}
+
+	void satisfySelfCollisions()
+	{
+		const float thicknessSqr = thickness * thickness;
+		for (const glm::ivec2& pair : collisionPairs)
+		{
+			const glm::vec3 p1_to_p2 = cloth.positions[pair.y] - cloth.positions[pair.x];
+			const float distanceSqr = glm::dot(p1_to_p2, p1_to_p2);
+			if (distanceSqr >= thicknessSqr || distanceSqr == 0.f)
+			{
+				continue;
+			}
+			const float current_distance = sqrt(distanceSqr);
+			moveParticles(pair.x, pair.y, p1_to_p2 / current_distance, current_distance - thickness);
+		}
+	}
+
+	// Verlet integration of every awake particle over one substep, the accelerations are kept for the next substeps.
+	// The damping is spread over the substeps so the cloth loses as much velocity per frame whatever their count.
+	void integrate(float substepSize, float substepDamping)
+	{
+		const float substepSize2 = substepSize * substepSize;
+		for (size_t i = 0; i < cloth.particleCount(); i++)
+		{
+			if (cloth.inverseMasses[i] != 0.f && !sleeping.particleAsleep[i])
+			{
+				const glm::vec3 temp = cloth.positions[i];
+				cloth.positions[i] += (cloth.positions[i] - cloth.oldPositions[i]) * (1.0f - substepDamping) + cloth.accelerations[i] * substepSize2;
+				cloth.oldPositions[i] = temp;
+			}
+		}
+	}
+
+	// positions - oldPositions is the velocity times the substep size, keep the velocity when the substep size changes
+	void rescaleVelocities(float scale)
+	{
+		for (size_t i = 0; i < cloth.particleCount(); i++)
+		{
+			cloth.oldPositions[i] = cloth.positions[i] - (cloth.positions[i] - cloth.oldPositions[i]) * scale;
+		}
+	}
+
+	template <typename Constraint>
+	static void resetLambdas(std::vector<Constraint>& constraints)
+	{
+		for (Constraint& constraint : constraints)
+		{
+			constraint.lambda = 0.f;
+		}
+	}
+
+	// Called once the constraints of the last substep are solved, before the integration, so that positions - oldPositions
+	// is the motion the constraints left and not the one gravity is about to add
+	void updateSleeping()
+	{
+		if (!sleepingEnabled)
+		{
+			sleeping.wakeAll();
+			return;
+		}
+
+		const float sleepDistanceSqr = sleepDistance * sleepDistance;
+		const float wakeDistanceSqr = 4.f * sleepDistanceSqr;
+		aerodynamicAccelerations.resize(cloth.particleCount(), glm::vec3(0.f));
+		sleepAerodynamicAccelerations.resize(cloth.particleCount(), glm::vec3(0.f));
+
+		// a sleeping particle is not integrated, so positions - oldPositions is how far it was pushed since it fell asleep
+		clusterMovesSqr.resize(sleeping.clusterCount());
+		parallelFor(threadPool, sleeping.clusterCount(), 16, [&](size_t begin, size_t end) {
+			for (size_t cluster = begin; cluster < end; cluster++)
+			{
+				float maxMoveSqr = 0.f;
+				for (int i = sleeping.clusterStart[cluster]; i < sleeping.clusterStart[cluster + 1]; i++)
+				{
+					const int p = sleeping.clusterParticles[i];
+					const glm::vec3 move = cloth.positions[p] - cloth.oldPositions[p];
+					maxMoveSqr = glm::max(maxMoveSqr, glm::dot(move, move));
+				}
+				clusterMovesSqr[cluster] = maxMoveSqr;
+			}
+		});
+
+		for (int cluster = 0; cluster < sleeping.clusterCount(); cluster++)
+		{
+			if (sleeping.clusterAsleep[cluster])
+			{
+				if (clusterMovesSqr[cluster] > wakeDistanceSqr)
+				{
+					sleeping.setClusterAsleep(cluster, false);
+				}
+			}
+			else if (clusterMovesSqr[cluster] >= sleepDistanceSqr)
+			{
+				sleeping.clusterQuietSteps[cluster] = 0;
+			}
+			else if (++sleeping.clusterQuietSteps[cluster] >= ClothSleeping::SleepStepCount)
+			{
+				sleeping.setClusterAsleep(cluster, true);
+				for (int i = sleeping.clusterStart[cluster]; i < sleeping.clusterStart[cluster + 1]; i++)
+				{
+					const int p = sleeping.clusterParticles[i];
+					cloth.oldPositions[p] = cloth.positions[p];
+					sleepAerodynamicAccelerations[p] = aerodynamicAccelerations[p];
+				}
+			}
+		}
+
+		// a moving particle wakes up the sleeping clusters it is constrained to
+		for (const ClothConstraint& constraint : cloth.constraints)
+		{
+			if (sleeping.particleAsleep[constraint.p1] == sleeping.particleAsleep[constraint.p2])
+			{
+				continue;
+			}
+			const int awake = sleeping.particleAsleep[constraint.p1] ? constraint.p2 : constraint.p1;
+			const int asleep = awake == constraint.p1 ? constraint.p2 : constraint.p1;
+			const glm::vec3 move = cloth.positions[awake] - cloth.oldPositions[awake];
+			if (glm::dot(move, move) > wakeDistanceSqr)
+			{
+				sleeping.wakeParticle(asleep);
+			}
+		}
+	}
+
+	void updateColoring()
+	{
+		if (solver == eClothSolver::GraphColored && coloring.constraintsRevision != cloth.constraintsRevision)
+		{
+			colorClothConstraints(cloth, cloth.constraints, coloring, coloringConflicts);
+			colorDurationsMs.assign(coloring.colorCount(), 0.f);
+		}
+		if (bending && bendingColoring.constraintsRevision != cloth.constraintsRevision)
+		{
+			colorClothConstraints(cloth, cloth.bendingConstraints, bendingColoring, bendingColoringConflicts);
+		}
+	}
+
+	// Every range of a parallelFor accumulates its errors in its own taskResiduals slot, merged once the sweep is done
+	void resetTaskResiduals(size_t itemCount, size_t grainSize)
+	{
+		taskResiduals.assign((itemCount + grainSize - 1) / grainSize, ClothResidual());
+	}
+
+	void mergeTaskResiduals(ClothResidual& residual) const
+	{
+		for (const ClothResidual& taskResidual : taskResiduals)
+		{
+			residual.merge(taskResidual);
+		}
+	}
+
+	// One Gauss-Seidel sweep over every constraint of constraintColoring, each color sees the corrections of the previous ones.
+	// project(constraint) returns the error of the constraint, pColorDurationsMs accumulates the time spent on each color.
+	template <typename Constraint, typename Project>
+	ClothResidual satisfyColored(ClothColoring<Constraint>& constraintColoring, bool lastColorConflicts, float* pColorDurationsMs, const Project& project)
+	{
+		constexpr size_t constraintsPerTask = 512;
+		ClothResidual residual;
+		for (int color = 0; color < constraintColoring.colorCount(); color++)
+		{
+			const auto colorStart = std::chrono::steady_clock::now();
+
+			Constraint* pConstraints = constraintColoring.constraints.data() + constraintColoring.colorStart[color];
+			const size_t constraintCount = constraintColoring.colorSize(color);
+			resetTaskResiduals(constraintCount, constraintsPerTask);
+			const auto satisfyRange = [&](size_t begin, size_t end) {
+				ClothResidual rangeResidual;
+				for (size_t i = begin; i < end; i++)
+				{
+					if (!sleeping.isAsleep(pConstraints[i]))
+					{
+						rangeResidual.add(project(pConstraints[i]));
+					}
+				}
+				taskResiduals[begin / constraintsPerTask].merge(rangeResidual);
+			};
+
+			const bool lastColor = color == constraintColoring.colorCount() - 1;
+			if (lastColor && lastColorConflicts)
+			{
+				satisfyRange(0, constraintCount);
+			}
+			else
+			{
+				parallelFor(threadPool, constraintCount, constraintsPerTask, satisfyRange);
+			}
+			mergeTaskResiduals(residual);
+
+			if (pColorDurationsMs)
+			{
+				pColorDurationsMs[color] += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - colorStart).count();
+			}
+		}
+		return residual;
+	}
+
+	// A negative invSubstepSize2 selects the PBD projection
+	ClothResidual satisfyConstraintsColored(float invSubstepSize2)
+	{
+		return satisfyColored(coloring, coloringConflicts, colorDurationsMs.data(), [&](ClothConstraint& constraint) {
+			return invSubstepSize2 >= 0.f ? satisfyConstraintXpbd(constraint, invSubstepSize2) : satisfyConstraint(constraint);
+		});
+	}
+
+	void satisfyBendingConstraints(float invSubstepSize2)
+	{
+		satisfyColored(bendingColoring, bendingColoringConflicts, nullptr, [&](ClothBendingConstraint& constraint) {
+			satisfyBendingConstraint(constraint, invSubstepSize2);
+			return 0.f;
+		});
+	}
+
+	// Coarse to fine: every level is solved from the positions left by the coarser ones, then the particles it
+	// leaves out move by the interpolation of its corrections. The low frequencies of the error, which take many
+	// iterations to cross the fine cloth, are removed by the coarse levels for a fraction of the cost.
+	void satisfyHierarchy()
+	{
+		constexpr size_t particlesPerTask = 1024;
+		const int levelCount = glm::min(hierarchyLevelCount, int(hierarchy.levels.size()));
+		for (int l = levelCount - 1; l >= 0; l--)
+		{
+			ClothHierarchyLevel& level = hierarchy.levels[l];
+			if (level.coloringOutdated)
+			{
+				colorClothConstraints(cloth, level.constraints, level.coloring, level.coloringConflicts);
+				level.coloringOutdated = false;
+			}
+
+			level.startPositions.resize(level.particles.size());
+			for (size_t i = 0; i < level.particles.size(); i++)
+			{
+				level.startPositions[i] = cloth.positions[level.particles[i]];
+			}
+
+			for (int i = 0; i < hierarchyIterations; i++)
+			{
+				satisfyColored(level.coloring, level.coloringConflicts, nullptr, [&](ClothConstraint& constraint) {
+					return satisfyStretchConstraint(constraint);
+				});
+			}
+
+			parallelFor(threadPool, level.interpolatedParticles.size(), particlesPerTask, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+				{
+					const int p = level.interpolatedParticles[i];
+					if (cloth.inverseMasses[p] == 0.f || sleeping.particleAsleep[p])
+					{
+						continue;
+					}
+					const glm::ivec4 coarseParticles = level.interpolationParticles[i];
+					const glm::vec4 weights = level.interpolationWeights[i];
+					glm::vec3 correction = glm::vec3(0.f);
+					for (int k = 0; k < 4; k++)
+					{
+						correction += weights[k] * (cloth.positions[level.particles[coarseParticles[k]]] - level.startPositions[coarseParticles[k]]);
+					}
+					cloth.positions[p] += correction;
+				}
+			});
+		}
+	}
+
+	// One Jacobi sweep: each particle only reads the previous iterate and writes its own new position,
+	// so the particles are solved in parallel without any write conflict
+	// Every constraint is measured by both of its particles, which does not change the max nor the RMS of the errors.
+	ClothResidual satisfyConstraintsJacobi()
+	{
+		if (adjacency.constraintsRevision != cloth.constraintsRevision)
+		{
+			buildClothAdjacency(cloth, adjacency);
+		}
+		jacobiPositions.resize(cloth.particleCount());
+
+		constexpr size_t particlesPerTask = 1024;
+		resetTaskResiduals(cloth.particleCount(), particlesPerTask);
+		parallelFor(threadPool, cloth.particleCount(), particlesPerTask, [&](size_t begin, size_t end) {
+			ClothResidual rangeResidual;
+			for (size_t p = begin; p < end; p++)
+			{
+				const glm::vec3 position = cloth.positions[p];
+				const float w = cloth.inverseMasses[p];
+				const int firstConstraint = adjacency.particleStart[p];
+				const int constraintCount = adjacency.particleEnd[p] - firstConstraint;
+				if (w == 0.f || constraintCount == 0 || sleeping.particleAsleep[p])
+				{
+					jacobiPositions[p] = position;
+					continue;
+				}
+
+				glm::vec3 correction = glm::vec3(0.f);
+				for (int i = firstConstraint; i < firstConstraint + constraintCount; i++)
+				{
+					const ClothConstraint& constraint = cloth.constraints[adjacency.constraints[i]];
+					const int other = constraint.p1 == int(p) ? constraint.p2 : constraint.p1;
+					const glm::vec3 toOther = cloth.positions[other] - position;
+					const float current_distance = glm::length(toOther);
+					if (current_distance == 0.f)
+					{
+						continue;
+					}
+					// same share of the correction as satisfyConstraint gives to this particle
+					const float share = w / (w + cloth.inverseMasses[other]);
+					correction += toOther * (share * (current_distance - constraint.restDistance) / current_distance);
+					rangeResidual.add(relativeError(constraint, current_distance - constraint.restDistance));
+				}
+				jacobiPositions[p] = position + correction * (jacobiOverRelaxation / constraintCount);
+			}
+			taskResiduals[begin / particlesPerTask].merge(rangeResidual);
+		});
+
+		cloth.positions.swap(jacobiPositions);
+
+		ClothResidual residual;
+		mergeTaskResiduals(residual);
+		return residual;
+	}
+
+	/* this is an important methods where the time is progressed one time step for the entire cloth.
+	This includes calling satisfyConstraint() for every constraint, and integrating all particles
+	*/
+	void timeStep()
+	{
+		std::chrono::steady_clock::duration collisionDuration{};
+		std::chrono::steady_clock::duration colliderDuration{};
+		std::chrono::steady_clock::duration meshQueryDuration{};
+		const bool collide = collisions && !colliders.empty();
+		const bool collideMesh = meshCollisions && !meshCollider.empty();
+		meshQueryCount = 0;
+
+		// nothing moves until something wakes the cloth up
+		const bool clothAsleep = sleeping.allAsleep();
+
+		if (selfCollision)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			if (!clothAsleep && collisionPairsOutdated())
+			{
+				findCollisionPairs();
+			}
+			collisionDuration += std::chrono::steady_clock::now() - start;
+		}
+		else
+		{
+			collisionPairs.clear();
+			collisionPairsPositions.clear();
+		}
+
+		updateColoring();
+		std::fill(colorDurationsMs.begin(), colorDurationsMs.end(), 0.f);
+
+		std::chrono::steady_clock::duration solveDuration{};
+
+		const bool implicit = integrator == eClothIntegrator::ImplicitEuler;
+		const int stepSubstepCount = implicit ? 1 : substepCount;
+		const float substepSize = TIME_STEPSIZE / stepSubstepCount;
+		const float substepDamping = 1.f - pow(1.f - DAMPING, 1.f / stepSubstepCount);
+		if (stepSubstepCount != integratedSubstepCount)
+		{
+			rescaleVelocities(float(integratedSubstepCount) / float(stepSubstepCount));
+			integratedSubstepCount = stepSubstepCount;
+		}
+
+		// the Jacobi solver has no Lagrange multipliers, it always uses the PBD projection
+		const bool useXpbd = xpbd && solver != eClothSolver::Jacobi;
+		std::vector<ClothConstraint>& solvedConstraints = solver == eClothSolver::GraphColored ? coloring.constraints : cloth.constraints;
+
+		iterationMaxErrors.clear();
+		iterationRmsErrors.clear();
+		solvedIterationCount = 0;
+		tornConstraintCount = 0;
+
+		// the implicit step integrates the stretch springs only: the bending constraints, the tethers and the self collisions
+		// are then projected once, outside of the implicit system
+		if (implicit && !clothAsleep)
+		{
+			const auto solveStart = std::chrono::steady_clock::now();
+			implicitStep(substepSize, substepDamping);
+			if (bending)
+			{
+				resetLambdas(bendingColoring.constraints);
+				satisfyBendingConstraints(1.f / (substepSize * substepSize));
+			}
+			if (tethers)
+			{
+				satisfyTethers();
+			}
+			solveDuration += std::chrono::steady_clock::now() - solveStart;
+
+			if (collide)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				satisfyColliders();
+				colliderDuration += std::chrono::steady_clock::now() - start;
+			}
+			if (collideMesh)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				meshQueryCount += satisfyMeshCollider();
+				meshQueryDuration += std::chrono::steady_clock::now() - start;
+			}
+
+			if (selfCollision)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				satisfySelfCollisions();
+				collisionDuration += std::chrono::steady_clock::now() - start;
+			}
+
+			if (tearing)
+			{
+				tearOverstretchedConstraints();
+			}
+			updateSleeping();
+			maxStretch = measureMaxStretch();
+		}
+
+		std::chrono::steady_clock::duration hierarchyDuration{};
+		for (int substep = 0; substep < (clothAsleep || implicit ? 0 : substepCount); substep++)
+		{
+			if (hierarchyLevelCount > 0)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				satisfyHierarchy();
+				hierarchyDuration += std::chrono::steady_clock::now() - start;
+			}
+
+			const float invSubstepSize2 = 1.f / (substepSize * substepSize);
+			if (useXpbd)
+			{
+				resetLambdas(solvedConstraints);
+			}
+			if (bending)
+			{
+				resetLambdas(bendingColoring.constraints);
+			}
+
+			for (int i = 0; i < iterationCount; i++) // iterate over all constraints several times
+			{
+				const auto solveStart = std::chrono::steady_clock::now();
+				ClothResidual residual;
+				if (solver == eClothSolver::GraphColored)
+				{
+					residual = satisfyConstraintsColored(useXpbd ? invSubstepSize2 : -1.f);
+				}
+				else if (solver == eClothSolver::Jacobi)
+				{
+					residual = satisfyConstraintsJacobi();
+				}
+				else
+				{
+					for (ClothConstraint& constraint : cloth.constraints)
+					{
+						if (sleeping.isAsleep(constraint))
+						{
+							continue;
+						}
+						if (useXpbd)
+						{
+							residual.add(satisfyConstraintXpbd(constraint, invSubstepSize2));
+						}
+						else
+						{
+							residual.add(satisfyConstraint(constraint));
+						}
+					}
+				}
+				if (bending)
+				{
+					satisfyBendingConstraints(invSubstepSize2);
+				}
+				// the tethers are solved last, so the stretch left by the other constraints is bounded whatever the iteration count
+				if (tethers)
+				{
+					residual.maxError = glm::max(residual.maxError, satisfyTethers().maxError);
+				}
+				solveDuration += std::chrono::steady_clock::now() - solveStart;
+
+				if (collide)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					satisfyColliders();
+					colliderDuration += std::chrono::steady_clock::now() - start;
+				}
+				if (collideMesh)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					meshQueryCount += satisfyMeshCollider();
+					meshQueryDuration += std::chrono::steady_clock::now() - start;
+				}
+
+				iterationMaxErrors.push_back(residual.maxError);
+				iterationRmsErrors.push_back(residual.rmsError());
+				solvedIterationCount++;
+
+				if (selfCollision)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					satisfySelfCollisions();
+					collisionDuration += std::chrono::steady_clock::now() - start;
+				}
+
+				// the errors are measured before each projection, so the cloth was already within the tolerance when this sweep started
+				if (earlyExit && residual.maxError < errorTolerance)
+				{
+					break;
+				}
+			}
+
+			if (substep == substepCount - 1)
+			{
+				if (tearing)
+				{
+					tearOverstretchedConstraints();
+				}
+				updateSleeping();
+				maxStretch = measureMaxStretch();
+			}
+			integrate(substepSize, substepDamping); // calculate the position of each particle at the next substep.
+		}
+		std::fill(cloth.accelerations.begin(), cloth.accelerations.end(), glm::vec3(0.f));
+
+		collisionDurationMs = std::chrono::duration<float, std::milli>(collisionDuration).count();
+		colliderDurationMs = std::chrono::duration<float, std::milli>(colliderDuration).count();
+		meshQueryDurationMs = std::chrono::duration<float, std::milli>(meshQueryDuration).count();
+		solveDurationMs = std::chrono::duration<float, std::milli>(solveDuration).count();
+		hierarchyDurationMs = std::chrono::duration<float, std::milli>(hierarchyDuration).count();
+
+		iterationHistory[iterationHistoryOffset] = float(solvedIterationCount);
+		iterationHistoryOffset = (iterationHistoryOffset + 1) % IterationHistorySize;
+	}
+
+	// Every range stages its free and awake particles by batches of ColliderBatchSize, collide(x, y, z, count) moves them
+	// and they are written back. Returns the number of staged particles.
+	template <typename Collide>
+	size_t collideStagedParticles(Collide collide)
+	{
+		constexpr size_t particlesPerTask = 1024;
+		std::atomic<size_t> stagedCount{ 0 };
+		parallelFor(threadPool, cloth.particleCount(), particlesPerTask, [&](size_t begin, size_t end) {
+			float x[ColliderBatchSize];
+			float y[ColliderBatchSize];
+			float z[ColliderBatchSize];
+			int particles[ColliderBatchSize];
+			size_t taskStagedCount = 0;
+			for (size_t p = begin; p < end; )
+			{
+				size_t count = 0;
+				for (; p < end && count < ColliderBatchSize; p++)
+				{
+					if (cloth.inverseMasses[p] == 0.f || sleeping.particleAsleep[p])
+					{
+						continue;
+					}
+					particles[count] = int(p);
+					x[count] = cloth.positions[p].x;
+					y[count] = cloth.positions[p].y;
+					z[count] = cloth.positions[p].z;
+					count++;
+				}
+
+				collide(x, y, z, count);
+				for (size_t i = 0; i < count; i++)
+				{
+					cloth.positions[particles[i]] = glm::vec3(x[i], y[i], z[i]);
+				}
+				taskStagedCount += count;
+			}
+			stagedCount += taskStagedCount;
+		});
+		return stagedCount;
+	}
+
+	void satisfyColliders()
+	{
+		collideStagedParticles([&](float* x, float* y, float* z, size_t count) {
+			collideParticleBatch(colliderSimdLevel, colliders, colliderThickness, x, y, z, count);
+		});
+	}
+
+	// Returns the number of mesh queries, one per staged particle
+	size_t satisfyMeshCollider()
+	{
+		return collideStagedParticles([&](float* x, float* y, float* z, size_t count) {
+			collideMeshColliderBatch(meshCollider, colliderThickness, x, y, z, count);
+		});
+	}
+
+	// Pinned and sleeping particles keep their velocity, the implicit system does not solve for them
+	bool isImplicitlyFixed(size_t particle) const
+	{
+		return cloth.inverseMasses[particle] == 0.f || sleeping.particleAsleep[particle];
+	}
+
+	// Every row only reads the constraints of its particle, so the rows are assembled in parallel.
+	// The spring forces f and their Jacobians are evaluated at the current positions and implicitVelocities.
+	void assembleImplicitSystem(float h)
+	{
+		implicitMatrix.resize(adjacency);
+		implicitRhs.resize(cloth.particleCount());
+
+		constexpr size_t particlesPerTask = 1024;
+		parallelFor(threadPool, cloth.particleCount(), particlesPerTask, [&](size_t begin, size_t end) {
+			for (size_t p = begin; p < end; p++)
+			{
+				const int firstConstraint = adjacency.particleStart[p];
+				const int lastConstraint = adjacency.particleEnd[p];
+				if (isImplicitlyFixed(p))
+				{
+					implicitMatrix.diagonal[p] = glm::mat3(1.f);
+					for (int i = firstConstraint; i < lastConstraint; i++)
+					{
+						implicitMatrix.offDiagonal[i] = glm::mat3(0.f);
+						implicitMatrix.columns[i] = int(p);
+					}
+					implicitRhs[p] = glm::vec3(0.f);
+					continue;
+				}
+
+				const float mass = 1.f / cloth.inverseMasses[p];
+				glm::vec3 force = cloth.accelerations[p] * mass;
+				glm::vec3 forceJacobianTimesVelocity = glm::vec3(0.f);
+				glm::mat3 diagonal = glm::mat3(mass);
+				for (int i = firstConstraint; i < lastConstraint; i++)
+				{
+					const ClothConstraint& constraint = cloth.constraints[adjacency.constraints[i]];
+					const int other = constraint.p1 == int(p) ? constraint.p2 : constraint.p1;
+					implicitMatrix.columns[i] = other;
+					implicitMatrix.offDiagonal[i] = glm::mat3(0.f);
+
+					const glm::vec3 other_to_p = cloth.positions[p] - cloth.positions[other];
+					const float current_distance = glm::length(other_to_p);
+					if (current_distance == 0.f)
+					{
+						continue;
+					}
+					const glm::vec3 direction = other_to_p / current_distance;
+					const glm::mat3 directionProjection = glm::outerProduct(direction, direction);
+					const glm::vec3 relativeVelocity = implicitVelocities[p] - implicitVelocities[other];
+
+					// the transverse stiffness is dropped under compression to keep the system positive definite
+					const float transverse = glm::max(0.f, 1.f - constraint.restDistance / current_distance);
+					const glm::mat3 stiffness = -springStiffness * (directionProjection + transverse * (glm::mat3(1.f) - directionProjection)); // df_p/dx_p
+					const glm::mat3 damping = -springDamping * directionProjection; // df_p/dv_p
+
+					force += -springStiffness * (current_distance - constraint.restDistance) * direction + damping * relativeVelocity;
+					forceJacobianTimesVelocity += stiffness * relativeVelocity;
+					diagonal -= h * damping + h * h * stiffness;
+					if (!isImplicitlyFixed(other))
+					{
+						implicitMatrix.offDiagonal[i] = h * damping + h * h * stiffness;
+					}
+				}
+				implicitMatrix.diagonal[p] = diagonal;
+				implicitRhs[p] = h * (force + h * forceJacobianTimesVelocity);
+			}
+		});
+	}
+
+	float parallelDot(const std::vector<glm::vec3>& a, const std::vector<glm::vec3>& b)
+	{
+		constexpr size_t particlesPerTask = 2048;
+		taskSums.assign((a.size() + particlesPerTask - 1) / particlesPerTask, 0.f);
+		parallelFor(threadPool, a.size(), particlesPerTask, [&](size_t begin, size_t end) {
+			float sum = 0.f;
+			for (size_t i = begin; i < end; i++)
+			{
+				sum += glm::dot(a[i], b[i]);
+			}
+			taskSums[begin / particlesPerTask] = sum;
+		});
 
-struct ClothViewer : Viewer
-{
-	glm::vec2 mousePos;
+		float sum = 0.f;
+		for (float taskSum : taskSums)
+		{
+			sum += taskSum;
+		}
+		return sum;
+	}
 
-	bool leftMouseButtonPressed;
-	bool altKeyPressed;
+	// Conjugate gradient on implicitMatrix * cgDeltaVelocities = implicitRhs, preconditioned by the inverses of the diagonal blocks
+	void solveImplicitSystem()
+	{
+		constexpr size_t particlesPerTask = 1024;
+		const size_t particleCount = cloth.particleCount();
+		implicitPreconditioner.resize(particleCount);
+		cgDeltaVelocities.assign(particleCount, glm::vec3(0.f));
+		cgResidual = implicitRhs;
+		cgPreconditioned.resize(particleCount);
+		cgDirection.resize(particleCount);
+		cgProduct.resize(particleCount);
 
-	// Tweakable data
-	int clothWidth = 10;
-	int clothHeight = 10;
-	float width = 5;
-	float height = 5;
+		parallelFor(threadPool, particleCount, particlesPerTask, [&](size_t begin, size_t end) {
+			for (size_t p = begin; p < end; p++)
+			{
+				implicitPreconditioner[p] = glm::inverse(implicitMatrix.diagonal[p]);
+				cgPreconditioned[p] = implicitPreconditioner[p] * cgResidual[p];
+				cgDirection[p] = cgPreconditioned[p];
+			}
+		});
 
-	glm::vec3 windForce = glm::vec3(0, 0, 0);
-	glm::vec3 gravity = glm::vec3(0, 0, 0);
+		const float rhsNormSqr = parallelDot(implicitRhs, implicitRhs);
+		const float toleranceSqr = cgTolerance * cgTolerance * rhsNormSqr;
+		float residualDotPreconditioned = parallelDot(cgResidual, cgPreconditioned);
+		float residualNormSqr = rhsNormSqr;
 
-	float oldElapsedTime;
+		cgIterationCount = 0;
+		while (cgIterationCount < maxCgIterations && residualNormSqr > toleranceSqr)
+		{
+			parallelFor(threadPool, particleCount, particlesPerTask, [&](size_t begin, size_t end) {
+				multiplyClothBlockMatrix(implicitMatrix, adjacency, cgDirection.data(), cgProduct.data(), begin, end);
+			});
+			const float directionDotProduct = parallelDot(cgDirection, cgProduct);
+			if (directionDotProduct <= 0.f)
+			{
+				break;
+			}
+			const float alpha = residualDotPreconditioned / directionDotProduct;
 
-	std::vector<ClothParticle*> particleList; // all particles that are part of this cloth
-	std::vector<Constraint*> constraintList; // alle constraints between particles as part of this cloth
+			parallelFor(threadPool, particleCount, particlesPerTask, [&](size_t begin, size_t end) {
+				for (size_t p = begin; p < end; p++)
+				{
+					cgDeltaVelocities[p] += alpha * cgDirection[p];
+					cgResidual[p] -= alpha * cgProduct[p];
+					cgPreconditioned[p] = implicitPreconditioner[p] * cgResidual[p];
+				}
+			});
+			residualNormSqr = parallelDot(cgResidual, cgResidual);
+			const float newResidualDotPreconditioned = parallelDot(cgResidual, cgPreconditioned);
+			const float beta = newResidualDotPreconditioned / residualDotPreconditioned;
+			residualDotPreconditioned = newResidualDotPreconditioned;
 
-	ClothParticle* getParticle(int x, int y) { return particleList[y * clothWidth + x]; }
-	void makeConstraint(ClothParticle* p1, ClothParticle* p2) { constraintList.push_back(new Constraint(p1, p2)); }
+			parallelFor(threadPool, particleCount, particlesPerTask, [&](size_t begin, size_t end) {
+				for (size_t p = begin; p < end; p++)
+				{
+					cgDirection[p] = cgPreconditioned[p] + beta * cgDirection[p];
+				}
+			});
+			cgIterationCount++;
+		}
+		cgRelativeResidual = rhsNormSqr > 0.f ? sqrtf(residualNormSqr / rhsNormSqr) : 0.f;
+	}
 
-	ClothViewer() : Viewer(clothViewerName, 1280, 720) {}
+	// One backward Euler step of size h: (M - h * df/dv - h^2 * df/dx) * dv = h * (f + h * df/dx * v), then x += h * (v + dv)
+	void implicitStep(float h, float damping)
+	{
+		if (adjacency.constraintsRevision != cloth.constraintsRevision)
+		{
+			buildClothAdjacency(cloth, adjacency);
+		}
 
-	static float distance(glm::vec3 position1, glm::vec3 position2) {
-		float xSqr = (position1.x - position2.x) * (position1.x - position2.x);
-		float ySqr = (position1.y - position2.y) * (position1.y - position2.y);
-		float zSqr = (position1.z - position2.z) * (position1.z - position2.z);
+		implicitVelocities.resize(cloth.particleCount());
+		for (size_t p = 0; p < cloth.particleCount(); p++)
+		{
+			implicitVelocities[p] = (cloth.positions[p] - cloth.oldPositions[p]) / h;
+		}
 
-		float sqr = xSqr + ySqr + zSqr;
+		const auto assemblyStart = std::chrono::steady_clock::now();
+		assembleImplicitSystem(h);
+		assemblyDurationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - assemblyStart).count();
 
-		return sqrt(sqr);
+		solveImplicitSystem();
+
+		for (size_t p = 0; p < cloth.particleCount(); p++)
+		{
+			if (!isImplicitlyFixed(p))
+			{
+				cloth.oldPositions[p] = cloth.positions[p];
+				cloth.positions[p] += (implicitVelocities[p] + cgDeltaVelocities[p]) * ((1.f - damping) * h);
+			}
+		}
 	}
 
-	void deleteRandomConstraint() 
+	float measureMaxStretch() const
 	{
-		int index = rand() % clothWidth* clothHeight;
-		for (int i = 0; i < constraintList.size(); i++) 
+		float stretch = 0.f;
+		for (const ClothConstraint& constraint : cloth.constraints)
 		{
-			if (index == i)
-				constraintList.erase(constraintList.begin() + i);
+			stretch = glm::max(stretch, glm::distance(cloth.positions[constraint.p1], cloth.positions[constraint.p2]) / constraint.restDistance - 1.f);
 		}
+		return stretch;
 	}
 
-	/* this is an important methods where the time is progressed one time step for the entire cloth.
-	This includes calling satisfyConstraint() for every constraint, and calling timeStep() for all particles
-	*/
-	void timeStep()
+	// The index buffers only change with the triangles and the constraints of the cloth
+	void updateIndexBuffers()
 	{
-		for (int i = 0; i < CONSTRAINT_ITERATIONS; i++) // iterate over all constraints several times
+		if (triangleIndicesRevision != cloth.trianglesRevision)
+		{
+			deleteIndexBuffer3D(triangleIndices);
+			createIndexBuffer3D(triangleIndices, (unsigned int const*)cloth.triangles.data(), GLsizei(3 * cloth.triangles.size()));
+			triangleIndicesRevision = cloth.trianglesRevision;
+		}
+		if (edgeIndicesRevision != cloth.constraintsRevision)
 		{
-			for (size_t i = 0; i < constraintList.size(); i++)
+			std::vector<unsigned int> indices;
+			indices.reserve(2 * cloth.constraints.size());
+			for (const ClothConstraint& constraint : cloth.constraints)
 			{
-				constraintList[i]->satisfyConstraint(); // satisfy constraint.
+				indices.push_back(constraint.p1);
+				indices.push_back(constraint.p2);
 			}
+			deleteIndexBuffer3D(edgeIndices);
+			createIndexBuffer3D(edgeIndices, indices.data(), GLsizei(indices.size()));
+			edgeIndicesRevision = cloth.constraintsRevision;
 		}
+		if (meshIndicesTriangleCount != meshCollider.triangles.size())
+		{
+			deleteIndexBuffer3D(meshIndices);
+			createIndexBuffer3D(meshIndices, (unsigned int const*)meshCollider.triangles.data(), GLsizei(3 * meshCollider.triangles.size()));
+			meshIndicesTriangleCount = meshCollider.triangles.size();
+		}
+	}
 
-		std::vector<Particle>::iterator particle;
-		for (size_t i = 0; i < particleList.size(); i++)
+	// The face normals are computed in parallel, then each particle gathers the ones of its triangles
+	void updateNormals()
+	{
+		if (triangleAdjacency.trianglesRevision != cloth.trianglesRevision)
 		{
-			particleList[i]->timeStep(); // calculate the position of each particle at the next time step.
+			buildClothTriangleAdjacency(cloth, triangleAdjacency);
 		}
+
+		faceNormals.resize(cloth.triangles.size());
+		parallelFor(threadPool, cloth.triangles.size(), 2048, [&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++)
+			{
+				const glm::ivec3 triangle = cloth.triangles[t];
+				const glm::vec3 p0 = cloth.positions[triangle.x];
+				faceNormals[t] = glm::cross(cloth.positions[triangle.y] - p0, cloth.positions[triangle.z] - p0);
+			}
+		});
+
+		normals.resize(cloth.particleCount());
+		parallelFor(threadPool, cloth.particleCount(), 2048, [&](size_t begin, size_t end) {
+			for (size_t p = begin; p < end; p++)
+			{
+				glm::vec3 normal = glm::vec3(0.f);
+				for (int i = triangleAdjacency.particleStart[p]; i < triangleAdjacency.particleEnd[p]; i++)
+				{
+					normal += faceNormals[triangleAdjacency.triangles[i]];
+				}
+				const float length = glm::length(normal);
+				normals[p] = length > 0.f ? normal / length : glm::vec3(0.f, 0.f, 1.f);
+			}
+		});
 	}
 
 	void addClothForce(glm::vec3 force) 
 	{
-		for (size_t i = 0; i < particleList.size(); i++)
+		for (size_t i = 0; i < cloth.particleCount(); i++)
 		{
-			particleList[i]->addForce(force);
+			cloth.accelerations[i] += force * cloth.inverseMasses[i];
 		}
 	}
 
 	void applyAirFriction()
 	{
 		const float friction_coef = 0.5f;
-		for (size_t i = 0; i < particleList.size(); i++)
+		for (glm::vec3& acceleration : cloth.accelerations)
 		{
-			particleList[i]->Velocity *= -friction_coef;
+			acceleration *= -friction_coef;
 		}
 	}
 
-	void initCloth() 
+	AerodynamicParameters aerodynamicParameters() const
+	{
+		// every particle weighs 1, the drag is scaled by the particles per unit of area so that the cloth flies the same at any resolution
+		AerodynamicParameters parameters;
+		parameters.wind = windForce;
+		parameters.turbulence = turbulence * glm::length(windForce);
+		parameters.drag = dragCoefficient / (particleSpacing.x * particleSpacing.y);
+		// positions - oldPositions covers one substep of the last timeStep
+		parameters.inverseStepSize = float(integratedSubstepCount) / TIME_STEPSIZE;
+		return parameters;
+	}
+
+	// Forces of the cloth triangles in the last wind field with the scalar path and with windSimdLevel, to check that
+	// the SIMD paths give the same forces
+	void compareWindSimdLevels()
+	{
+		const size_t triangleCount = cloth.triangles.size();
+		if (windField.resolution < 2 || triangleCount == 0)
+		{
+			return;
+		}
+		const AerodynamicParameters parameters = aerodynamicParameters();
+		std::vector<float> scalar(3 * triangleCount);
+		std::vector<float> simd(3 * triangleCount);
+		computeAerodynamicForces(eSimdLevel::Scalar, windField, parameters, cloth.positions.data(), cloth.oldPositions.data(), cloth.triangles.data(),
+			0, triangleCount, &scalar[0], &scalar[triangleCount], &scalar[2 * triangleCount]);
+		computeAerodynamicForces(windSimdLevel, windField, parameters, cloth.positions.data(), cloth.oldPositions.data(), cloth.triangles.data(),
+			0, triangleCount, &simd[0], &simd[triangleCount], &simd[2 * triangleCount]);
+		windSimdDifference = 0.f;
+		windSimdMaxForce = 0.f;
+		for (size_t i = 0; i < scalar.size(); i++)
+		{
+			windSimdDifference = glm::max(windSimdDifference, fabsf(simd[i] - scalar[i]));
+			windSimdMaxForce = glm::max(windSimdMaxForce, fabsf(scalar[i]));
+		}
+	}
+
+	// The wind field is baked slice by slice and the forces are computed triangle by triangle in parallel,
+	// then each particle gathers a third of the forces of its triangles
+	void applyAerodynamicForces(float deltaTime)
 	{
-		constraintList.clear();
+		const auto start = std::chrono::steady_clock::now();
+		if (triangleAdjacency.trianglesRevision != cloth.trianglesRevision)
+		{
+			buildClothTriangleAdjacency(cloth, triangleAdjacency);
+		}
+
+		glm::vec3 boundsMin = cloth.positions[0];
+		glm::vec3 boundsMax = cloth.positions[0];
+		for (const glm::vec3& position : cloth.positions)
+		{
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+		resizeWindField(windField, boundsMin, boundsMax, windFieldResolution);
+		windFieldOffset -= windForce * (deltaTime * turbulenceFrequency);
+		parallelFor(threadPool, size_t(windFieldResolution), 1, [&](size_t begin, size_t end) {
+			bakeWindFieldSlices(windField, turbulenceFrequency, windFieldOffset, begin, end);
+		});
 
-		particleList.clear();
-		particleList.resize(clothWidth * clothHeight); //I am essentially using this vector as an array with room for num_particles_width*num_particles_height particles
+		const AerodynamicParameters parameters = aerodynamicParameters();
+		const size_t triangleCount = cloth.triangles.size();
+		triangleForcesX.resize(triangleCount);
+		triangleForcesY.resize(triangleCount);
+		triangleForcesZ.resize(triangleCount);
+		parallelFor(threadPool, triangleCount, 2048, [&](size_t begin, size_t end) {
+			computeAerodynamicForces(windSimdLevel, windField, parameters, cloth.positions.data(), cloth.oldPositions.data(), cloth.triangles.data(),
+				begin, end, triangleForcesX.data(), triangleForcesY.data(), triangleForcesZ.data());
+		});
+
+		aerodynamicAccelerations.resize(cloth.particleCount());
+		parallelFor(threadPool, cloth.particleCount(), 2048, [&](size_t begin, size_t end) {
+			for (size_t p = begin; p < end; p++)
+			{
+				glm::vec3 force = glm::vec3(0.f);
+				for (int i = triangleAdjacency.particleStart[p]; i < triangleAdjacency.particleEnd[p]; i++)
+				{
+					const int triangle = triangleAdjacency.triangles[i];
+					force += glm::vec3(triangleForcesX[triangle], triangleForcesY[triangle], triangleForcesZ[triangle]);
+				}
+				aerodynamicAccelerations[p] = force * (cloth.inverseMasses[p] / 3.f);
+				cloth.accelerations[p] += aerodynamicAccelerations[p];
+			}
+		});
+		wakeClustersInChangedWind();
+		aerodynamicsDurationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
 
-		// Creating particles in a grid of particles from (0,0,0) to (width,-height,0)
-		for (int x = 0; x < clothWidth; x++)
+	// A sleeping cluster rests under the aerodynamic forces it fell asleep with. It wakes up when the acceleration of one
+	// of its particles changed enough to move it by more than the wake distance within a substep, the calm parts of a
+	// turbulent wind keep sleeping.
+	void wakeClustersInChangedWind()
+	{
+		if (sleeping.sleepingClusterCount == 0 || sleepAerodynamicAccelerations.size() != cloth.particleCount())
 		{
-			for (int y = 0; y < clothHeight; y++)
+			return;
+		}
+		const float substepSize = TIME_STEPSIZE / integratedSubstepCount;
+		const float wakeAcceleration = 2.f * sleepDistance / (substepSize * substepSize);
+		const float wakeAccelerationSqr = wakeAcceleration * wakeAcceleration;
+
+		clusterWindChanged.assign(sleeping.clusterCount(), 0);
+		parallelFor(threadPool, sleeping.clusterCount(), 16, [&](size_t begin, size_t end) {
+			for (size_t cluster = begin; cluster < end; cluster++)
+			{
+				if (!sleeping.clusterAsleep[cluster])
+				{
+					continue;
+				}
+				for (int i = sleeping.clusterStart[cluster]; i < sleeping.clusterStart[cluster + 1]; i++)
+				{
+					const int p = sleeping.clusterParticles[i];
+					const glm::vec3 change = aerodynamicAccelerations[p] - sleepAerodynamicAccelerations[p];
+					if (glm::dot(change, change) > wakeAccelerationSqr)
+					{
+						clusterWindChanged[cluster] = 1;
+						break;
+					}
+				}
+			}
+		});
+		for (int cluster = 0; cluster < sleeping.clusterCount(); cluster++)
+		{
+			if (clusterWindChanged[cluster])
 			{
-				glm::vec3 pos = glm::vec3(width * (x / (float)clothWidth), height * (y / (float)clothHeight), 0);
-				particleList[y * clothWidth + x] = new ClothParticle(pos); // insert particle in column x at y'th row
+				sleeping.setClusterAsleep(cluster, false);
 			}
 		}
+	}
+
+	void initCloth() 
+	{
+		cloth.clear();
+
+		// clothCount grids of a side of 1 / columnCount of the rectangle from (0,0,0) to (width,height,0), the grids of the
+		// following layout rows are one grid width further back. Each grid is stored row by row so that getParticle(g, x, y) is firstParticle + y * clothWidth + x
+		const int columnCount = int(ceilf(sqrtf(float(clothCount))));
+		const float scale = 1.f / columnCount;
+		particleSpacing = glm::vec2(width * scale / clothWidth, height * scale / clothHeight);
+		for (int g = 0; g < clothCount; g++)
+		{
+			const glm::vec3 origin = glm::vec3(width * scale * (g % columnCount), 0.f, -width * scale * (g / columnCount));
+			cloth.addGrid(clothWidth, clothHeight, origin, particleSpacing, 1.f);
+		}
 
-		// Connecting immediate neighbor particles with constraints (distance 1 and sqrt(2) in the grid)
-		for (int x = 0; x < clothWidth; x++)
+		for (int g = 0; g < clothCount; g++)
 		{
-			for (int y = 0; y < clothHeight; y++)
+			// Connecting immediate neighbor particles with constraints (distance 1 and sqrt(2) in the grid)
+			for (int x = 0; x < clothWidth; x++)
 			{
-				if (x < clothWidth - 1) makeConstraint(getParticle(x, y), getParticle(x + 1, y));
-				if (y < clothHeight - 1) makeConstraint(getParticle(x, y), getParticle(x, y + 1));
+				for (int y = 0; y < clothHeight; y++)
+				{
+					if (x < clothWidth - 1) makeConstraint(getParticle(g, x, y), getParticle(g, x + 1, y));
+					if (y < clothHeight - 1) makeConstraint(getParticle(g, x, y), getParticle(g, x, y + 1));
+
+					// Uncomment to add diagonal neighbors
+					//if (x < clothWidth - 1 && y < clothHeight - 1) makeConstraint(getParticle(g, x, y), getParticle(g, x + 1, y + 1));
+					//if (x < clothWidth - 1 && y < clothHeight - 1) makeConstraint(getParticle(g, x + 1, y), getParticle(g, x, y + 1));
+
+					if (x < clothWidth - 1 && y < clothHeight - 1) makeQuad(getParticle(g, x, y), getParticle(g, x + 1, y), getParticle(g, x + 1, y + 1), getParticle(g, x, y + 1));
+				}
+			}
 
-				// Uncomment to add diagonal neighbors
-				//if (x < clothWidth - 1 && y < clothHeight - 1) makeConstraint(getParticle(x, y), getParticle(x + 1, y + 1));
-				//if (x < clothWidth - 1 && y < clothHeight - 1) makeConstraint(getParticle(x + 1, y), getParticle(x, y + 1));
+			// Making the upper left most three and right most three particles unmovable
+			for (int i = 0; i < 2; i++)
+			{
+				cloth.pin(getParticle(g, 0 + i, 0));
+				cloth.pin(getParticle(g, clothWidth - 1 - i, 0));
 			}
 		}
 
-		// Connecting secondary neighbors with constraints (distance 2 and sqrt(4) in the grid)
-		//for (int x = 0; x < clothWidth; x++)
-		//{
-		//	for (int y = 0; y < clothHeight; y++)
-		//	{
-		//		if (x < clothWidth - 2) makeConstraint(getParticle(x, y), getParticle(x + 2, y));
-		//		if (y < clothHeight - 2) makeConstraint(getParticle(x, y), getParticle(x, y + 2));
-		//		if (x < clothWidth - 2 && y < clothHeight - 2) makeConstraint(getParticle(x, y), getParticle(x + 2, y + 2));
-		//		if (x < clothWidth - 2 && y < clothHeight - 2) makeConstraint(getParticle(x + 2, y), getParticle(x, y + 2));
-		//	}
-		//}
+		// Bending resistance across every edge shared by two triangles of the grids
+		cloth.addBendingConstraints(bendingCompliance);
+		cloth.attachTethers();
+
+		buildClothAdjacency(cloth, adjacency);
 
-		// Making the upper left most three and right most three particles unmovable
-		for (int i = 0; i < 2; i++)
+		// every grid has its own clusters
+		const int clusterCountX = (clothWidth + SleepClusterSize - 1) / SleepClusterSize;
+		const int clusterCountY = (clothHeight + SleepClusterSize - 1) / SleepClusterSize;
+		std::vector<int> particleClusters(cloth.particleCount());
+		for (int g = 0; g < clothCount; g++)
 		{
-			getParticle(0 + i, 0)->makeUnmovable();
-			getParticle(clothWidth - 1 - i, 0)->makeUnmovable();
+			for (int y = 0; y < clothHeight; y++)
+			{
+				for (int x = 0; x < clothWidth; x++)
+				{
+					particleClusters[getParticle(g, x, y)] = (g * clusterCountY + y / SleepClusterSize) * clusterCountX + x / SleepClusterSize;
+				}
+			}
 		}
+		initClothSleeping(sleeping, particleClusters, clothCount * clusterCountX * clusterCountY);
+
+		buildClothHierarchy(cloth, hierarchy);
 	}
 
 	void init() override 
@@ -235,7 +1707,154 @@ struct ClothViewer : Viewer
 
 		altKeyPressed = false;
 
+		workerCount = defaultThreadPoolWorkerCount();
+		createThreadPool(threadPool, workerCount);
+
 		initCloth();
+
+		colliderSimdLevel = detectSimdLevel();
+		windSimdLevel = detectSimdLevel();
+		initColliders();
+		buildWavyMeshCollider();
+	}
+
+	// Around the cloth at rest, which spans [0, width] x [0, height] in the z = 0 plane
+	void initColliders()
+	{
+		colliders = ColliderSet();
+		colliders.spheres.push_back({ glm::vec3(1.5f, 3.f, 1.2f), 0.8f });
+		colliders.capsules.push_back({ glm::vec3(3.f, 1.f, -1.2f), glm::vec3(4.f, 4.f, -1.2f), 0.5f });
+		colliders.planes.push_back({ glm::vec3(0.f, 1.f, 0.f), -6.f });
+
+		// a torus, baked once so that the particles only sample the grid
+		constexpr float majorRadius = 1.f;
+		constexpr float minorRadius = 0.3f;
+		const glm::vec3 torusCenter = glm::vec3(2.5f, -3.f, 0.f);
+		colliders.sdfGrids.emplace_back();
+		bakeSdfGridCollider(colliders.sdfGrids.back(), torusCenter - glm::vec3(1.5f), 0.1f, glm::ivec3(31), [&](const glm::vec3& position) {
+			const glm::vec3 local = position - torusCenter;
+			const glm::vec2 toTube = glm::vec2(glm::length(glm::vec2(local.x, local.z)) - majorRadius, local.y);
+			return glm::length(toTube) - minorRadius;
+		});
+	}
+
+	// Wavy floor between the torus and the ground plane, its hierarchy is built from scratch
+	void buildWavyMeshCollider()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		makeWavyMeshCollider(meshCollider, meshCenter, meshSize, meshResolution, meshAmplitude, meshTime);
+		buildMeshCollider(meshCollider);
+		meshBuildDurationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		meshColliderResolution = meshResolution;
+
+		computeMeshColliderNormals(meshCollider, meshNormals);
+		sleeping.wakeAll();
+	}
+
+	// The triangles stay the same, so the hierarchy keeps its nodes and only has their bounds refit
+	void animateMeshCollider(float deltaTime)
+	{
+		meshTime += deltaTime;
+		makeWavyMeshCollider(meshCollider, meshCenter, meshSize, meshColliderResolution, meshAmplitude, meshTime);
+		const auto start = std::chrono::steady_clock::now();
+		refitMeshCollider(meshCollider);
+		meshRefitDurationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		computeMeshColliderNormals(meshCollider, meshNormals);
+		wakeClustersNearMeshCollider();
+	}
+
+	// The sleeping particles would not notice the moving mesh, the clusters with a particle within the collision
+	// distance of its bounds wake up and the others keep sleeping
+	void wakeClustersNearMeshCollider()
+	{
+		if (sleeping.sleepingClusterCount == 0 || meshCollider.empty())
+		{
+			return;
+		}
+		const glm::vec3 boundsMin = meshCollider.nodes[0].boundsMin - glm::vec3(colliderThickness);
+		const glm::vec3 boundsMax = meshCollider.nodes[0].boundsMax + glm::vec3(colliderThickness);
+		for (int cluster = 0; cluster < sleeping.clusterCount(); cluster++)
+		{
+			if (!sleeping.clusterAsleep[cluster])
+			{
+				continue;
+			}
+			for (int i = sleeping.clusterStart[cluster]; i < sleeping.clusterStart[cluster + 1]; i++)
+			{
+				const glm::vec3 position = cloth.positions[sleeping.clusterParticles[i]];
+				if (glm::all(glm::greaterThanEqual(position, boundsMin)) && glm::all(glm::lessThanEqual(position, boundsMax)))
+				{
+					sleeping.setClusterAsleep(cluster, false);
+					break;
+				}
+			}
+		}
+	}
+
+	// Pushes random particles around the colliders out of them with the scalar path and with colliderSimdLevel, to check
+	// that the SIMD paths give the same positions
+	void compareColliderSimdLevels()
+	{
+		constexpr size_t particleCount = 1 << 16;
+		std::uniform_real_distribution<float> randomCoordinate(-6.f, 6.f);
+		std::vector<float> scalar(3 * particleCount);
+		for (float& coordinate : scalar)
+		{
+			coordinate = randomCoordinate(randomEngine);
+		}
+		std::vector<float> simd = scalar;
+
+		for (size_t i = 0; i < particleCount; i += ColliderBatchSize)
+		{
+			const size_t count = glm::min(ColliderBatchSize, particleCount - i);
+			collideParticleBatch(eSimdLevel::Scalar, colliders, colliderThickness, &scalar[i], &scalar[particleCount + i], &scalar[2 * particleCount + i], count);
+			collideParticleBatch(colliderSimdLevel, colliders, colliderThickness, &simd[i], &simd[particleCount + i], &simd[2 * particleCount + i], count);
+		}
+		colliderSimdDifference = 0.f;
+		for (size_t i = 0; i < scalar.size(); i++)
+		{
+			colliderSimdDifference = glm::max(colliderSimdDifference, fabsf(simd[i] - scalar[i]));
+		}
+	}
+
+	// Queries at random positions within the bounds of the mesh on every worker, to measure how the throughput scales with the triangle count
+	void benchmarkMeshQueries()
+	{
+		if (meshCollider.empty())
+		{
+			return;
+		}
+
+		constexpr size_t queryCount = 1 << 20;
+		const MeshColliderNode& root = meshCollider.nodes[0];
+		std::uniform_real_distribution<float> randomX(root.boundsMin.x, root.boundsMax.x);
+		std::uniform_real_distribution<float> randomY(root.boundsMin.y - colliderThickness, root.boundsMax.y + colliderThickness);
+		std::uniform_real_distribution<float> randomZ(root.boundsMin.z, root.boundsMax.z);
+		std::vector<float> x(queryCount);
+		std::vector<float> y(queryCount);
+		std::vector<float> z(queryCount);
+		for (size_t i = 0; i < queryCount; i++)
+		{
+			x[i] = randomX(randomEngine);
+			y[i] = randomY(randomEngine);
+			z[i] = randomZ(randomEngine);
+		}
+
+		std::atomic<size_t> testedTriangleCount{ 0 };
+		const auto start = std::chrono::steady_clock::now();
+		parallelFor(threadPool, queryCount, 4 * ColliderBatchSize, [&](size_t begin, size_t end) {
+			size_t taskTestedTriangleCount = 0;
+			for (size_t i = begin; i < end; i += ColliderBatchSize)
+			{
+				taskTestedTriangleCount += collideMeshColliderBatch(meshCollider, colliderThickness, &x[i], &y[i], &z[i], glm::min(ColliderBatchSize, end - i));
+			}
+			testedTriangleCount += taskTestedTriangleCount;
+		});
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		benchmarkQueriesPerSecond = queryCount / seconds;
+		benchmarkTrianglesPerQuery = double(testedTriangleCount) / queryCount;
 	}
 
 	void update(double elapsedTime) override
@@ -254,12 +1873,40 @@ struct ClothViewer : Viewer
 		float deltaTime = elapsedTime - oldElapsedTime;
 		oldElapsedTime = elapsedTime;
 
+		resizeThreadPool(threadPool, workerCount);
+
 		float random = (float)(rand() % 10) * 0.01f;
-		glm::vec3 force = random * windForce;
+		glm::vec3 force = aerodynamics ? glm::vec3(0.f) : random * windForce;
+		// a sleeping cluster rests under the forces it fell asleep with, any change of the uniform ones wakes the whole cloth.
+		// The aerodynamic forces only wake the clusters where they changed, see wakeClustersInChangedWind.
+		const glm::vec3 externalAcceleration = gravity + (aerodynamics ? windForce : force);
+		if (externalAcceleration != lastExternalAcceleration)
+		{
+			sleeping.wakeAll();
+			lastExternalAcceleration = externalAcceleration;
+		}
+		if (meshCollisions && animateMesh)
+		{
+			animateMeshCollider(deltaTime);
+		}
+
 		addClothForce(gravity);
 		addClothForce(force);
 		applyAirFriction();
+		if (aerodynamics)
+		{
+			applyAerodynamicForces(deltaTime);
+		}
+
+		const auto stepStart = std::chrono::steady_clock::now();
 		timeStep();
+		stepDurationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - stepStart).count();
+
+		updateIndexBuffers();
+		if (drawClothMesh)
+		{
+			updateNormals();
+		}
 	}
 
 	void render3D_custom(const RenderApi3D& api) const override
@@ -272,19 +1919,37 @@ struct ClothViewer : Viewer
 		//api.grid(10.f, 10, glm::vec4(0.5f, 0.5f, 0.5f, 1.f), nullptr);
 		//api.axisXYZ(nullptr);
 
-		for (size_t i = 0; i < particleList.size(); i++)
+		const unsigned int particleCount = (unsigned int)cloth.particleCount();
+		if (drawClothMesh && normals.size() == particleCount && triangleIndices.ibo)
 		{
-			api.solidSphere(particleList[i]->Position, 0.08f, 10, 10, boidsGreen);
+			api.streamedMesh(cloth.positions.data(), normals.data(), particleCount, triangleIndices, eDrawMode::Triangles, boidsGreen);
 		}
-
-		for (size_t i = 0; i < constraintList.size(); i++)
+		if (drawWireframe && edgeIndices.ibo)
+		{
+			api.streamedMesh(cloth.positions.data(), nullptr, particleCount, edgeIndices, eDrawMode::Lines, glm::vec4(0.5f, 0.5f, 0.5f, 1.f));
+		}
+		if (drawParticles)
 		{
-			glm::vec3 vertices[2] =
+			// a third of the grid spacing, so that the spheres of a fine cloth do not hide each other
+			const float radius = glm::min(0.08f, 0.3f * glm::min(particleSpacing.x, particleSpacing.y));
+			std::vector<float> radii(particleCount, radius);
+			std::vector<glm::vec4> colors(particleCount, boidsGreen);
+			for (size_t i = 0; i < particleCount; i++)
 			{
-				constraintList[i]->p1->Position,
-				constraintList[i]->p2->Position
-			};
-			api.lines(vertices, 2, glm::vec4(0.5f, 0.5f, 0.5f, 1.f), nullptr);
+				if (sleeping.particleAsleep[i])
+				{
+					colors[i] = glm::vec4(0.3f, 0.4f, 0.6f, 1.f);
+				}
+			}
+			api.instancedSpheres(cloth.positions.data(), radii.data(), colors.data(), particleCount);
+		}
+		if (collisions)
+		{
+			drawColliders(api, colliders, glm::vec4(0.6f, 0.6f, 0.6f, 1.f));
+		}
+		if (meshCollisions && meshIndices.ibo && meshNormals.size() == meshCollider.vertices.size())
+		{
+			api.streamedMesh(meshCollider.vertices.data(), meshNormals.data(), (unsigned int)meshCollider.vertices.size(), meshIndices, eDrawMode::Triangles, glm::vec4(0.6f, 0.5f, 0.4f, 1.f));
 		}
 	}
 
@@ -313,6 +1978,207 @@ struct ClothViewer : Viewer
 		}
 	}
 
+	void drawConstraintSolverGUI()
+	{
+		ImGui::RadioButton("Sequential solver", (int*)&solver, (int)eClothSolver::Sequential);
+		ImGui::SameLine();
+		ImGui::RadioButton("Graph colored solver", (int*)&solver, (int)eClothSolver::GraphColored);
+		ImGui::SameLine();
+		ImGui::RadioButton("Jacobi solver", (int*)&solver, (int)eClothSolver::Jacobi);
+		if (solver != eClothSolver::Sequential)
+		{
+			ImGui::SliderInt("Worker threads", &workerCount, 0, 2 * (defaultThreadPoolWorkerCount() + 1));
+		}
+		ImGui::SliderInt("Iterations", &iterationCount, 1, 50);
+		ImGui::SliderInt("Substeps", &substepCount, 1, 20);
+		ImGui::Checkbox("XPBD", &xpbd);
+		if (xpbd)
+		{
+			if (ImGui::SliderFloat("Stretch compliance", &stretchCompliance, 0.f, 10.f, "%.5f", ImGuiSliderFlags_Logarithmic))
+			{
+				cloth.setCompliance(stretchCompliance);
+				if (coloring.constraintsRevision == cloth.constraintsRevision)
+				{
+					setClothColoredCompliance(coloring, stretchCompliance);
+				}
+			}
+			if (solver == eClothSolver::Jacobi)
+			{
+				ImGui::Text("The Jacobi solver ignores the compliance");
+			}
+		}
+		if (solver == eClothSolver::Jacobi)
+		{
+			ImGui::SliderFloat("Over-relaxation", &jacobiOverRelaxation, 1.f, 2.f);
+		}
+		if (solver == eClothSolver::GraphColored)
+		{
+			ImGui::Text("%d constraints in %d colors%s", int(coloring.constraints.size()), coloring.colorCount(), coloringConflicts ? ", last color solved sequentially" : "");
+			for (int color = 0; color < coloring.colorCount(); color++)
+			{
+				ImGui::Text("  color %d: %d constraints, %.3f ms", color, coloring.colorSize(color), colorDurationsMs[color]);
+			}
+		}
+		ImGui::SliderInt("Coarse levels", &hierarchyLevelCount, 0, int(hierarchy.levels.size()));
+		if (hierarchyLevelCount > 0)
+		{
+			ImGui::SliderInt("Coarse iterations", &hierarchyIterations, 1, 10);
+			for (int l = 0; l < hierarchyLevelCount && l < int(hierarchy.levels.size()); l++)
+			{
+				const ClothHierarchyLevel& level = hierarchy.levels[l];
+				ImGui::Text("  level %d: every %d particles, %d particles, %d constraints", l + 1, level.step, int(level.particles.size()), int(level.constraints.size()));
+			}
+			ImGui::Text("Coarse levels %.3f ms", hierarchyDurationMs);
+		}
+		ImGui::Checkbox("Tethers", &tethers);
+		ImGui::SameLine();
+		ImGui::Text("%d tethers to the pinned particles", int(cloth.tetherCount()));
+		ImGui::Checkbox("Bending", &bending);
+		if (bending)
+		{
+			if (ImGui::SliderFloat("Bending compliance", &bendingCompliance, 1e-4f, 100.f, "%.4f", ImGuiSliderFlags_Logarithmic))
+			{
+				cloth.setBendingCompliance(bendingCompliance);
+				if (bendingColoring.constraintsRevision == cloth.constraintsRevision)
+				{
+					setClothColoredCompliance(bendingColoring, bendingCompliance);
+				}
+			}
+			ImGui::Text("%d bending constraints in %d colors", int(bendingColoring.constraints.size()), bendingColoring.colorCount());
+		}
+		ImGui::Text("Constraint solve %.3f ms, max stretch %.2f%%", solveDurationMs, 100.f * maxStretch);
+
+		ImGui::Checkbox("Stop iterating below tolerance", &earlyExit);
+		if (earlyExit)
+		{
+			ImGui::SliderFloat("Error tolerance", &errorTolerance, 1e-6f, 1e-1f, "%.6f", ImGuiSliderFlags_Logarithmic);
+		}
+		const int iterationBudget = iterationCount * substepCount;
+		ImGui::Text("Iterations %d / %d (%.0f%% skipped)", solvedIterationCount, iterationBudget, 100.f * float(iterationBudget - solvedIterationCount) / float(iterationBudget));
+		if (!iterationMaxErrors.empty())
+		{
+			ImGui::Text("Last iteration error: max %.2e, RMS %.2e", iterationMaxErrors.back(), iterationRmsErrors.back());
+		}
+		// the errors span several orders of magnitude, plot their log10
+		std::vector<float> logMaxErrors(iterationMaxErrors.size());
+		std::vector<float> logRmsErrors(iterationRmsErrors.size());
+		for (size_t i = 0; i < iterationMaxErrors.size(); i++)
+		{
+			logMaxErrors[i] = log10f(glm::max(iterationMaxErrors[i], 1e-9f));
+			logRmsErrors[i] = log10f(glm::max(iterationRmsErrors[i], 1e-9f));
+		}
+		ImGui::PlotLines("log10 max error", logMaxErrors.data(), int(logMaxErrors.size()), 0, nullptr, -9.f, 0.f, ImVec2(0, 60));
+		ImGui::PlotLines("log10 RMS error", logRmsErrors.data(), int(logRmsErrors.size()), 0, nullptr, -9.f, 0.f, ImVec2(0, 60));
+		ImGui::PlotLines("Iterations per frame", iterationHistory, IterationHistorySize, iterationHistoryOffset, nullptr, 0.f, float(iterationBudget), ImVec2(0, 60));
+		float averageIterations = 0.f;
+		for (float iterations : iterationHistory)
+		{
+			averageIterations += iterations / IterationHistorySize;
+		}
+		ImGui::Text("%.1f iterations per frame on average, %.0f%% below the %d configured", averageIterations, 100.f * (1.f - averageIterations / iterationBudget), iterationBudget);
+	}
+
+	void drawCollidersGUI()
+	{
+		ImGui::Checkbox("Colliders", &collisions);
+		if (!collisions)
+		{
+			return;
+		}
+		ImGui::SliderFloat("Collider thickness", &colliderThickness, 0.f, 0.3f);
+		for (int level = 0; level <= (int)detectSimdLevel(); level++)
+		{
+			if (level > 0)
+			{
+				ImGui::SameLine();
+			}
+			ImGui::RadioButton(simdLevelName((eSimdLevel)level), (int*)&colliderSimdLevel, level);
+		}
+		if (ImGui::Button("Compare with scalar"))
+		{
+			compareColliderSimdLevels();
+		}
+		if (colliderSimdDifference >= 0.f)
+		{
+			ImGui::SameLine();
+			ImGui::Text("largest difference %.2e on 65536 particles", colliderSimdDifference);
+		}
+
+		// the sleeping particles would not notice a moved collider
+		bool moved = false;
+		moved |= ImGui::SliderFloat3("Sphere center", &colliders.spheres[0].center.x, -6.f, 6.f);
+		moved |= ImGui::SliderFloat("Sphere radius", &colliders.spheres[0].radius, 0.1f, 3.f);
+		moved |= ImGui::SliderFloat3("Capsule start", &colliders.capsules[0].a.x, -6.f, 6.f);
+		moved |= ImGui::SliderFloat3("Capsule end", &colliders.capsules[0].b.x, -6.f, 6.f);
+		moved |= ImGui::SliderFloat("Capsule radius", &colliders.capsules[0].radius, 0.1f, 2.f);
+		moved |= ImGui::SliderFloat("Floor height", &colliders.planes[0].offset, -10.f, 0.f);
+		if (moved)
+		{
+			sleeping.wakeAll();
+		}
+		ImGui::Text("%d SDF grid samples, colliders %.3f ms", int(colliders.sdfGrids[0].distances.size()), colliderDurationMs);
+	}
+
+	void drawAerodynamicsGUI()
+	{
+		ImGui::Checkbox("Aerodynamic wind", &aerodynamics);
+		if (!aerodynamics)
+		{
+			return;
+		}
+		ImGui::SliderFloat("Drag", &dragCoefficient, 0.f, 10.f);
+		ImGui::SliderFloat("Turbulence", &turbulence, 0.f, 2.f);
+		ImGui::SliderFloat("Turbulence frequency", &turbulenceFrequency, 0.05f, 5.f, "%.2f", ImGuiSliderFlags_Logarithmic);
+		ImGui::SliderInt("Wind field resolution", &windFieldResolution, 2, 64);
+		// the collider radio buttons have the same labels
+		ImGui::PushID("Wind");
+		for (int level = 0; level <= (int)detectSimdLevel(); level++)
+		{
+			if (level > 0)
+			{
+				ImGui::SameLine();
+			}
+			ImGui::RadioButton(simdLevelName((eSimdLevel)level), (int*)&windSimdLevel, level);
+		}
+		if (ImGui::Button("Compare with scalar"))
+		{
+			compareWindSimdLevels();
+		}
+		ImGui::PopID();
+		if (windSimdDifference >= 0.f)
+		{
+			ImGui::SameLine();
+			ImGui::Text("largest difference %.2e, largest force %.2e", windSimdDifference, windSimdMaxForce);
+		}
+		ImGui::Text("Aerodynamics %.3f ms, step %.3f ms", aerodynamicsDurationMs, stepDurationMs);
+	}
+
+	void drawMeshColliderGUI()
+	{
+		ImGui::Checkbox("Mesh collider", &meshCollisions);
+		if (!meshCollisions)
+		{
+			return;
+		}
+		// 708 quads per side make a million triangles
+		ImGui::SliderInt("Mesh resolution (quads)", &meshResolution, 2, 708);
+		if (ImGui::Button("Build mesh"))
+		{
+			buildWavyMeshCollider();
+		}
+		ImGui::SameLine();
+		ImGui::Checkbox("Animate mesh", &animateMesh);
+		ImGui::Text("%d triangles, %d nodes, build %.1f ms, refit %.3f ms", int(meshCollider.triangles.size()), int(meshCollider.nodes.size()), meshBuildDurationMs, meshRefitDurationMs);
+		const double queriesPerSecond = meshQueryDurationMs > 0.f ? 1000.0 * meshQueryCount / meshQueryDurationMs : 0.0;
+		ImGui::Text("%d queries in %.3f ms, %.2f M queries/s", int(meshQueryCount), meshQueryDurationMs, 1e-6 * queriesPerSecond);
+		if (ImGui::Button("Benchmark 1M queries"))
+		{
+			benchmarkMeshQueries();
+		}
+		ImGui::SameLine();
+		ImGui::Text("%.2f M queries/s, %.1f triangles tested per query", 1e-6 * benchmarkQueriesPerSecond, benchmarkTrianglesPerQuery);
+	}
+
 	void drawGUI() override {
 		static bool showDemoWindow = false;
 
@@ -323,15 +2189,69 @@ struct ClothViewer : Viewer
 		ImGui::Separator();
 		ImGui::SliderFloat3("Gravity", &gravity.x, -1.0f, 1.0f);
 		ImGui::SliderFloat3("Wind Force", &windForce.x, -3.0f, 3.0f);
+		drawAerodynamicsGUI();
 		if (ImGui::Button("Erase random constraint")) 
 		{
 			deleteRandomConstraint();
 		}
+		ImGui::Checkbox("Tearing", &tearing);
+		ImGui::SliderFloat("Tear strain", &tearStrain, 0.05f, 2.f, "%.2f");
+		ImGui::Text("%d constraints torn in the last step, %.3f ms", tornConstraintCount, tearDurationMs);
 
+		ImGui::SliderInt("Cloth width (particles)", &clothWidth, 2, 256);
+		ImGui::SliderInt("Cloth height (particles)", &clothHeight, 2, 256);
+		ImGui::SliderInt("Cloth count", &clothCount, 1, 64);
 		if (ImGui::Button("New Cloth"))
 		{
 			initCloth();
 		}
+		ImGui::Text("Cloth resolution and count are applied by New Cloth");
+		ImGui::Text("%d cloths packed in %d particles, %d constraints, %d triangles", int(cloth.grids.size()), int(cloth.particleCount()), int(cloth.constraints.size()), int(cloth.triangles.size()));
+		ImGui::Checkbox("Mesh", &drawClothMesh);
+		ImGui::SameLine();
+		ImGui::Checkbox("Wireframe", &drawWireframe);
+		ImGui::SameLine();
+		ImGui::Checkbox("Particles", &drawParticles);
+
+		ImGui::Separator();
+		ImGui::RadioButton("Verlet and constraints", (int*)&integrator, (int)eClothIntegrator::Verlet);
+		ImGui::SameLine();
+		ImGui::RadioButton("Implicit Euler", (int*)&integrator, (int)eClothIntegrator::ImplicitEuler);
+		if (integrator == eClothIntegrator::ImplicitEuler)
+		{
+			ImGui::SliderInt("Worker threads", &workerCount, 0, 2 * (defaultThreadPoolWorkerCount() + 1));
+			ImGui::SliderFloat("Spring stiffness", &springStiffness, 1.f, 1e5f, "%.1f", ImGuiSliderFlags_Logarithmic);
+			ImGui::SliderFloat("Spring damping", &springDamping, 0.f, 100.f, "%.3f", ImGuiSliderFlags_Logarithmic);
+			ImGui::SliderInt("Max CG iterations", &maxCgIterations, 1, 1000);
+			ImGui::SliderFloat("CG tolerance", &cgTolerance, 1e-8f, 1e-1f, "%.8f", ImGuiSliderFlags_Logarithmic);
+			ImGui::Checkbox("Tethers", &tethers);
+			ImGui::SameLine();
+			ImGui::Checkbox("Bending", &bending);
+			ImGui::Text("Only the stretch springs are implicit, the bending and the tethers are projected once after the step");
+			ImGui::Text("CG: %d iterations, relative residual %.2e", cgIterationCount, cgRelativeResidual);
+			ImGui::Text("Assembly %.3f ms, step %.3f ms, max stretch %.2f%%", assemblyDurationMs, solveDurationMs, 100.f * maxStretch);
+		}
+		else
+		{
+			drawConstraintSolverGUI();
+		}
+
+		ImGui::Separator();
+		ImGui::Checkbox("Sleeping", &sleepingEnabled);
+		if (sleepingEnabled)
+		{
+			ImGui::SliderFloat("Sleep distance", &sleepDistance, 1e-5f, 1e-1f, "%.5f", ImGuiSliderFlags_Logarithmic);
+		}
+		ImGui::Text("%d / %d clusters of %dx%d particles asleep", sleeping.sleepingClusterCount, sleeping.clusterCount(), SleepClusterSize, SleepClusterSize);
+
+		ImGui::Separator();
+		ImGui::Checkbox("Self collision", &selfCollision);
+		ImGui::SliderFloat("Thickness", &thickness, 0.01f, 0.3f);
+		ImGui::Text("Self collision: %d pairs, %.3f ms, %d hash rebuilds", int(collisionPairs.size()), collisionDurationMs, collisionPairsRebuildCount);
+
+		ImGui::Separator();
+		drawCollidersGUI();
+		drawMeshColliderGUI();
 		
 		ImGui::Separator();
 
@@ -342,6 +2262,7 @@ struct ClothViewer : Viewer
 		}
 
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		drawRenderStatsGUI();
 
 		ImGui::End();
 
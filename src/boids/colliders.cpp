@@ -0,0 +1,360 @@
+#include "colliders.h"
+#include "../renderapi.h"
+
+#include <glm/mat4x4.hpp>
+#include <assert.h>
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COLLIDERS_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define COLLIDERS_TARGET_AVX2
+#else
+#define COLLIDERS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define COLLIDERS_KERNEL_X86 0
+#endif
+
+namespace {
+	void collideSphere(const glm::vec3& center, float sphereRadius, float radius, glm::vec3& position) {
+		const glm::vec3 offset = position - center;
+		const float distanceSqr = glm::dot(offset, offset);
+		const float minDistance = sphereRadius + radius;
+		if (distanceSqr < minDistance * minDistance && distanceSqr > 1e-12f) {
+			position += offset * (minDistance / sqrtf(distanceSqr) - 1.f);
+		}
+	}
+
+	glm::vec3 closestCapsulePoint(const CapsuleCollider& capsule, const glm::vec3& position) {
+		const glm::vec3 axis = capsule.b - capsule.a;
+		const float axisLengthSqr = glm::dot(axis, axis);
+		const float t = axisLengthSqr > 0.f ? glm::clamp(glm::dot(position - capsule.a, axis) / axisLengthSqr, 0.f, 1.f) : 0.f;
+		return capsule.a + t * axis;
+	}
+
+	void collidePlane(const PlaneCollider& plane, float radius, glm::vec3& position) {
+		const float push = radius - (glm::dot(plane.normal, position) - plane.offset);
+		if (push > 0.f) {
+			position += push * plane.normal;
+		}
+	}
+
+	void collideSdfGrid(const SdfGridCollider& grid, float radius, glm::vec3& position) {
+		float distance;
+		glm::vec3 gradient;
+		if (sampleSdfGridCollider(grid, position, distance, gradient) && distance < radius) {
+			const float gradientLength = glm::length(gradient);
+			if (gradientLength > 1e-6f) {
+				position += gradient * ((radius - distance) / gradientLength);
+			}
+		}
+	}
+
+	// scalar path, also handles the particles left after the last full batch of lanes
+	void collideScalar(const ColliderSet& colliders, float radius, float* x, float* y, float* z, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			glm::vec3 position = glm::vec3(x[i], y[i], z[i]);
+			for (const SphereCollider& sphere : colliders.spheres) {
+				collideSphere(sphere.center, sphere.radius, radius, position);
+			}
+			for (const CapsuleCollider& capsule : colliders.capsules) {
+				collideSphere(closestCapsulePoint(capsule, position), capsule.radius, radius, position);
+			}
+			for (const PlaneCollider& plane : colliders.planes) {
+				collidePlane(plane, radius, position);
+			}
+			for (const SdfGridCollider& grid : colliders.sdfGrids) {
+				collideSdfGrid(grid, radius, position);
+			}
+			x[i] = position.x;
+			y[i] = position.y;
+			z[i] = position.z;
+		}
+	}
+
+#if COLLIDERS_KERNEL_X86
+	// Moves the lanes closer than minDistance to (cx, cy, cz) back to minDistance, away from it
+	void pushOutSSE2(__m128 cx, __m128 cy, __m128 cz, __m128 minDistance, __m128& px, __m128& py, __m128& pz) {
+		const __m128 dx = _mm_sub_ps(px, cx);
+		const __m128 dy = _mm_sub_ps(py, cy);
+		const __m128 dz = _mm_sub_ps(pz, cz);
+		const __m128 distanceSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		const __m128 inside = _mm_and_ps(_mm_cmplt_ps(distanceSqr, _mm_mul_ps(minDistance, minDistance)), _mm_cmpgt_ps(distanceSqr, _mm_set1_ps(1e-12f)));
+		const __m128 scale = _mm_and_ps(inside, _mm_sub_ps(_mm_div_ps(minDistance, _mm_sqrt_ps(distanceSqr)), _mm_set1_ps(1.f)));
+		px = _mm_add_ps(px, _mm_mul_ps(dx, scale));
+		py = _mm_add_ps(py, _mm_mul_ps(dy, scale));
+		pz = _mm_add_ps(pz, _mm_mul_ps(dz, scale));
+	}
+
+	// returns the index of the first particle left to the scalar loop
+	size_t collideSSE2(const ColliderSet& colliders, float radius, float* x, float* y, float* z, size_t count) {
+		const size_t laneCount = count / 4 * 4;
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+
+		for (const SphereCollider& sphere : colliders.spheres) {
+			const __m128 cx = _mm_set1_ps(sphere.center.x), cy = _mm_set1_ps(sphere.center.y), cz = _mm_set1_ps(sphere.center.z);
+			const __m128 minDistance = _mm_set1_ps(sphere.radius + radius);
+			for (size_t i = 0; i < laneCount; i += 4) {
+				__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+				pushOutSSE2(cx, cy, cz, minDistance, px, py, pz);
+				_mm_storeu_ps(x + i, px);
+				_mm_storeu_ps(y + i, py);
+				_mm_storeu_ps(z + i, pz);
+			}
+		}
+
+		for (const CapsuleCollider& capsule : colliders.capsules) {
+			const glm::vec3 axis = capsule.b - capsule.a;
+			const float axisLengthSqr = glm::dot(axis, axis);
+			const glm::vec3 scaledAxis = axisLengthSqr > 0.f ? axis / axisLengthSqr : glm::vec3(0.f);
+			const __m128 ax = _mm_set1_ps(capsule.a.x), ay = _mm_set1_ps(capsule.a.y), az = _mm_set1_ps(capsule.a.z);
+			const __m128 bx = _mm_set1_ps(axis.x), by = _mm_set1_ps(axis.y), bz = _mm_set1_ps(axis.z);
+			const __m128 sx = _mm_set1_ps(scaledAxis.x), sy = _mm_set1_ps(scaledAxis.y), sz = _mm_set1_ps(scaledAxis.z);
+			const __m128 minDistance = _mm_set1_ps(capsule.radius + radius);
+			for (size_t i = 0; i < laneCount; i += 4) {
+				__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+				const __m128 projection = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(px, ax), sx), _mm_mul_ps(_mm_sub_ps(py, ay), sy)), _mm_mul_ps(_mm_sub_ps(pz, az), sz));
+				const __m128 t = _mm_min_ps(_mm_max_ps(projection, zero), one);
+				pushOutSSE2(_mm_add_ps(ax, _mm_mul_ps(t, bx)), _mm_add_ps(ay, _mm_mul_ps(t, by)), _mm_add_ps(az, _mm_mul_ps(t, bz)), minDistance, px, py, pz);
+				_mm_storeu_ps(x + i, px);
+				_mm_storeu_ps(y + i, py);
+				_mm_storeu_ps(z + i, pz);
+			}
+		}
+
+		for (const PlaneCollider& plane : colliders.planes) {
+			const __m128 nx = _mm_set1_ps(plane.normal.x), ny = _mm_set1_ps(plane.normal.y), nz = _mm_set1_ps(plane.normal.z);
+			const __m128 offset = _mm_set1_ps(plane.offset + radius);
+			for (size_t i = 0; i < laneCount; i += 4) {
+				const __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+				const __m128 height = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, nx), _mm_mul_ps(py, ny)), _mm_mul_ps(pz, nz));
+				const __m128 push = _mm_max_ps(_mm_sub_ps(offset, height), zero);
+				_mm_storeu_ps(x + i, _mm_add_ps(px, _mm_mul_ps(push, nx)));
+				_mm_storeu_ps(y + i, _mm_add_ps(py, _mm_mul_ps(push, ny)));
+				_mm_storeu_ps(z + i, _mm_add_ps(pz, _mm_mul_ps(push, nz)));
+			}
+		}
+
+		for (const SdfGridCollider& grid : colliders.sdfGrids) {
+			for (size_t i = 0; i < laneCount; i++) {
+				glm::vec3 position = glm::vec3(x[i], y[i], z[i]);
+				collideSdfGrid(grid, radius, position);
+				x[i] = position.x;
+				y[i] = position.y;
+				z[i] = position.z;
+			}
+		}
+		return laneCount;
+	}
+
+	COLLIDERS_TARGET_AVX2 void pushOutAVX2(__m256 cx, __m256 cy, __m256 cz, __m256 minDistance, __m256& px, __m256& py, __m256& pz) {
+		const __m256 dx = _mm256_sub_ps(px, cx);
+		const __m256 dy = _mm256_sub_ps(py, cy);
+		const __m256 dz = _mm256_sub_ps(pz, cz);
+		const __m256 distanceSqr = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		const __m256 inside = _mm256_and_ps(_mm256_cmp_ps(distanceSqr, _mm256_mul_ps(minDistance, minDistance), _CMP_LT_OQ), _mm256_cmp_ps(distanceSqr, _mm256_set1_ps(1e-12f), _CMP_GT_OQ));
+		const __m256 scale = _mm256_and_ps(inside, _mm256_sub_ps(_mm256_div_ps(minDistance, _mm256_sqrt_ps(distanceSqr)), _mm256_set1_ps(1.f)));
+		px = _mm256_add_ps(px, _mm256_mul_ps(dx, scale));
+		py = _mm256_add_ps(py, _mm256_mul_ps(dy, scale));
+		pz = _mm256_add_ps(pz, _mm256_mul_ps(dz, scale));
+	}
+
+	// a + t * (b - a)
+	COLLIDERS_TARGET_AVX2 __m256 lerpAVX2(__m256 a, __m256 b, __m256 t) {
+		return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+	}
+
+	// The 8 corners of the cell of every lane are gathered, the lanes outside of the grid read a clamped cell and are masked out
+	COLLIDERS_TARGET_AVX2 void collideSdfGridAVX2(const SdfGridCollider& grid, float radius, float* x, float* y, float* z, size_t laneCount) {
+		const float* distances = grid.distances.data();
+		const __m256 originX = _mm256_set1_ps(grid.origin.x), originY = _mm256_set1_ps(grid.origin.y), originZ = _mm256_set1_ps(grid.origin.z);
+		const __m256 invCellSize = _mm256_set1_ps(1.f / grid.cellSize);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 maxCellX = _mm256_set1_ps(float(grid.size.x - 2)), maxCellY = _mm256_set1_ps(float(grid.size.y - 2)), maxCellZ = _mm256_set1_ps(float(grid.size.z - 2));
+		const __m256i strideY = _mm256_set1_epi32(grid.size.x);
+		const __m256i strideZ = _mm256_set1_epi32(grid.size.x * grid.size.y);
+		const __m256i strideX = _mm256_set1_epi32(1);
+		const __m256 radiusLanes = _mm256_set1_ps(radius);
+
+		for (size_t i = 0; i < laneCount; i += 8) {
+			__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+			const __m256 localX = _mm256_mul_ps(_mm256_sub_ps(px, originX), invCellSize);
+			const __m256 localY = _mm256_mul_ps(_mm256_sub_ps(py, originY), invCellSize);
+			const __m256 localZ = _mm256_mul_ps(_mm256_sub_ps(pz, originZ), invCellSize);
+			const __m256 cellX = _mm256_floor_ps(localX), cellY = _mm256_floor_ps(localY), cellZ = _mm256_floor_ps(localZ);
+			const __m256 inside = _mm256_and_ps(
+				_mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(cellX, zero, _CMP_GE_OQ), _mm256_cmp_ps(cellX, maxCellX, _CMP_LE_OQ)),
+					_mm256_and_ps(_mm256_cmp_ps(cellY, zero, _CMP_GE_OQ), _mm256_cmp_ps(cellY, maxCellY, _CMP_LE_OQ))),
+				_mm256_and_ps(_mm256_cmp_ps(cellZ, zero, _CMP_GE_OQ), _mm256_cmp_ps(cellZ, maxCellZ, _CMP_LE_OQ)));
+			if (_mm256_movemask_ps(inside) == 0) {
+				continue;
+			}
+
+			const __m256i index000 = _mm256_add_epi32(
+				_mm256_add_epi32(_mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(cellX, zero), maxCellX)),
+					_mm256_mullo_epi32(_mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(cellY, zero), maxCellY)), strideY)),
+				_mm256_mullo_epi32(_mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(cellZ, zero), maxCellZ)), strideZ));
+			const __m256i index010 = _mm256_add_epi32(index000, strideY);
+			const __m256i index001 = _mm256_add_epi32(index000, strideZ);
+			const __m256i index011 = _mm256_add_epi32(index010, strideZ);
+			const __m256 d000 = _mm256_i32gather_ps(distances, index000, 4);
+			const __m256 d100 = _mm256_i32gather_ps(distances, _mm256_add_epi32(index000, strideX), 4);
+			const __m256 d010 = _mm256_i32gather_ps(distances, index010, 4);
+			const __m256 d110 = _mm256_i32gather_ps(distances, _mm256_add_epi32(index010, strideX), 4);
+			const __m256 d001 = _mm256_i32gather_ps(distances, index001, 4);
+			const __m256 d101 = _mm256_i32gather_ps(distances, _mm256_add_epi32(index001, strideX), 4);
+			const __m256 d011 = _mm256_i32gather_ps(distances, index011, 4);
+			const __m256 d111 = _mm256_i32gather_ps(distances, _mm256_add_epi32(index011, strideX), 4);
+
+			const __m256 tx = _mm256_sub_ps(localX, cellX), ty = _mm256_sub_ps(localY, cellY), tz = _mm256_sub_ps(localZ, cellZ);
+			const __m256 d00 = lerpAVX2(d000, d100, tx), d10 = lerpAVX2(d010, d110, tx), d01 = lerpAVX2(d001, d101, tx), d11 = lerpAVX2(d011, d111, tx);
+			const __m256 d0 = lerpAVX2(d00, d10, ty), d1 = lerpAVX2(d01, d11, ty);
+			const __m256 distance = lerpAVX2(d0, d1, tz);
+
+			// derivatives of the trilinear interpolation, in cell units as only their direction is used
+			const __m256 gradientX = lerpAVX2(lerpAVX2(_mm256_sub_ps(d100, d000), _mm256_sub_ps(d110, d010), ty), lerpAVX2(_mm256_sub_ps(d101, d001), _mm256_sub_ps(d111, d011), ty), tz);
+			const __m256 gradientY = lerpAVX2(_mm256_sub_ps(d10, d00), _mm256_sub_ps(d11, d01), tz);
+			const __m256 gradientZ = _mm256_sub_ps(d1, d0);
+			const __m256 gradientLengthSqr = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gradientX, gradientX), _mm256_mul_ps(gradientY, gradientY)), _mm256_mul_ps(gradientZ, gradientZ));
+
+			const __m256 push = _mm256_sub_ps(radiusLanes, distance);
+			const __m256 colliding = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(push, zero, _CMP_GT_OQ), _mm256_cmp_ps(gradientLengthSqr, _mm256_set1_ps(1e-12f * grid.cellSize * grid.cellSize), _CMP_GT_OQ)));
+			const __m256 scale = _mm256_and_ps(colliding, _mm256_div_ps(push, _mm256_sqrt_ps(gradientLengthSqr)));
+			_mm256_storeu_ps(x + i, _mm256_add_ps(px, _mm256_mul_ps(gradientX, scale)));
+			_mm256_storeu_ps(y + i, _mm256_add_ps(py, _mm256_mul_ps(gradientY, scale)));
+			_mm256_storeu_ps(z + i, _mm256_add_ps(pz, _mm256_mul_ps(gradientZ, scale)));
+		}
+	}
+
+	COLLIDERS_TARGET_AVX2 size_t collideAVX2(const ColliderSet& colliders, float radius, float* x, float* y, float* z, size_t count) {
+		const size_t laneCount = count / 8 * 8;
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+
+		for (const SphereCollider& sphere : colliders.spheres) {
+			const __m256 cx = _mm256_set1_ps(sphere.center.x), cy = _mm256_set1_ps(sphere.center.y), cz = _mm256_set1_ps(sphere.center.z);
+			const __m256 minDistance = _mm256_set1_ps(sphere.radius + radius);
+			for (size_t i = 0; i < laneCount; i += 8) {
+				__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+				pushOutAVX2(cx, cy, cz, minDistance, px, py, pz);
+				_mm256_storeu_ps(x + i, px);
+				_mm256_storeu_ps(y + i, py);
+				_mm256_storeu_ps(z + i, pz);
+			}
+		}
+
+		for (const CapsuleCollider& capsule : colliders.capsules) {
+			const glm::vec3 axis = capsule.b - capsule.a;
+			const float axisLengthSqr = glm::dot(axis, axis);
+			const glm::vec3 scaledAxis = axisLengthSqr > 0.f ? axis / axisLengthSqr : glm::vec3(0.f);
+			const __m256 ax = _mm256_set1_ps(capsule.a.x), ay = _mm256_set1_ps(capsule.a.y), az = _mm256_set1_ps(capsule.a.z);
+			const __m256 bx = _mm256_set1_ps(axis.x), by = _mm256_set1_ps(axis.y), bz = _mm256_set1_ps(axis.z);
+			const __m256 sx = _mm256_set1_ps(scaledAxis.x), sy = _mm256_set1_ps(scaledAxis.y), sz = _mm256_set1_ps(scaledAxis.z);
+			const __m256 minDistance = _mm256_set1_ps(capsule.radius + radius);
+			for (size_t i = 0; i < laneCount; i += 8) {
+				__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+				const __m256 projection = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(px, ax), sx), _mm256_mul_ps(_mm256_sub_ps(py, ay), sy)), _mm256_mul_ps(_mm256_sub_ps(pz, az), sz));
+				const __m256 t = _mm256_min_ps(_mm256_max_ps(projection, zero), one);
+				pushOutAVX2(_mm256_add_ps(ax, _mm256_mul_ps(t, bx)), _mm256_add_ps(ay, _mm256_mul_ps(t, by)), _mm256_add_ps(az, _mm256_mul_ps(t, bz)), minDistance, px, py, pz);
+				_mm256_storeu_ps(x + i, px);
+				_mm256_storeu_ps(y + i, py);
+				_mm256_storeu_ps(z + i, pz);
+			}
+		}
+
+		for (const PlaneCollider& plane : colliders.planes) {
+			const __m256 nx = _mm256_set1_ps(plane.normal.x), ny = _mm256_set1_ps(plane.normal.y), nz = _mm256_set1_ps(plane.normal.z);
+			const __m256 offset = _mm256_set1_ps(plane.offset + radius);
+			for (size_t i = 0; i < laneCount; i += 8) {
+				const __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+				const __m256 height = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, nx), _mm256_mul_ps(py, ny)), _mm256_mul_ps(pz, nz));
+				const __m256 push = _mm256_max_ps(_mm256_sub_ps(offset, height), zero);
+				_mm256_storeu_ps(x + i, _mm256_add_ps(px, _mm256_mul_ps(push, nx)));
+				_mm256_storeu_ps(y + i, _mm256_add_ps(py, _mm256_mul_ps(push, ny)));
+				_mm256_storeu_ps(z + i, _mm256_add_ps(pz, _mm256_mul_ps(push, nz)));
+			}
+		}
+
+		for (const SdfGridCollider& grid : colliders.sdfGrids) {
+			collideSdfGridAVX2(grid, radius, x, y, z, laneCount);
+		}
+		return laneCount;
+	}
+#endif
+}
+
+bool sampleSdfGridCollider(const SdfGridCollider& grid, const glm::vec3& position, float& distance, glm::vec3& gradient) {
+	const glm::vec3 local = (position - grid.origin) / grid.cellSize;
+	const glm::vec3 cellCorner = glm::floor(local);
+	const glm::ivec3 cell = glm::ivec3(cellCorner);
+	if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x > grid.size.x - 2 || cell.y > grid.size.y - 2 || cell.z > grid.size.z - 2) {
+		return false;
+	}
+
+	const size_t strideY = size_t(grid.size.x);
+	const size_t strideZ = size_t(grid.size.x) * grid.size.y;
+	const float* d = grid.distances.data() + cell.z * strideZ + cell.y * strideY + cell.x;
+	const float d000 = d[0], d100 = d[1], d010 = d[strideY], d110 = d[strideY + 1];
+	const float d001 = d[strideZ], d101 = d[strideZ + 1], d011 = d[strideZ + strideY], d111 = d[strideZ + strideY + 1];
+
+	const glm::vec3 t = local - cellCorner;
+	const float d00 = glm::mix(d000, d100, t.x), d10 = glm::mix(d010, d110, t.x), d01 = glm::mix(d001, d101, t.x), d11 = glm::mix(d011, d111, t.x);
+	const float d0 = glm::mix(d00, d10, t.y), d1 = glm::mix(d01, d11, t.y);
+	distance = glm::mix(d0, d1, t.z);
+	gradient = glm::vec3(
+		glm::mix(glm::mix(d100 - d000, d110 - d010, t.y), glm::mix(d101 - d001, d111 - d011, t.y), t.z),
+		glm::mix(d10 - d00, d11 - d01, t.z),
+		d1 - d0) / grid.cellSize;
+	return true;
+}
+
+void collideParticleBatch(eSimdLevel level, const ColliderSet& colliders, float radius, float* x, float* y, float* z, size_t count) {
+	assert(level <= detectSimdLevel()); // the cpu can't run this kernel
+
+	size_t i = 0;
+#if COLLIDERS_KERNEL_X86
+	if (level == eSimdLevel::AVX2) {
+		i = collideAVX2(colliders, radius, x, y, z, count);
+	}
+	else if (level == eSimdLevel::SSE2) {
+		i = collideSSE2(colliders, radius, x, y, z, count);
+	}
+#endif
+	collideScalar(colliders, radius, x, y, z, i, count);
+}
+
+void drawColliders(const RenderApi3D& api, const ColliderSet& colliders, const glm::vec4& color) {
+	for (const SphereCollider& sphere : colliders.spheres) {
+		api.solidSphere(sphere.center, sphere.radius, 24, 16, color);
+	}
+
+	// capsules and SDF grids as spheres drawn in a single call
+	std::vector<glm::vec3> positions;
+	std::vector<float> radii;
+	for (const CapsuleCollider& capsule : colliders.capsules) {
+		const int sphereCount = 2 + int(glm::distance(capsule.a, capsule.b) / (0.25f * capsule.radius));
+		for (int i = 0; i < sphereCount; i++) {
+			positions.push_back(glm::mix(capsule.a, capsule.b, float(i) / float(sphereCount - 1)));
+			radii.push_back(capsule.radius);
+		}
+	}
+	for (const SdfGridCollider& grid : colliders.sdfGrids) {
+		positions.insert(positions.end(), grid.surfacePoints.begin(), grid.surfacePoints.end());
+		radii.resize(positions.size(), 0.6f * grid.cellSize);
+	}
+	if (!positions.empty()) {
+		std::vector<glm::vec4> colors(positions.size(), color);
+		api.instancedSpheres(positions.data(), radii.data(), colors.data(), (unsigned int)positions.size());
+	}
+
+	// the grid is drawn in the xz plane of its model, whose y axis is the normal
+	for (const PlaneCollider& plane : colliders.planes) {
+		const glm::vec3 tangent = glm::normalize(glm::cross(plane.normal, glm::abs(plane.normal.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 0.f, 1.f)));
+		const glm::vec3 bitangent = glm::cross(tangent, plane.normal);
+		const glm::mat4 model = glm::mat4(glm::vec4(tangent, 0.f), glm::vec4(plane.normal, 0.f), glm::vec4(bitangent, 0.f), glm::vec4(plane.offset * plane.normal, 1.f));
+		api.grid(20.f, 20, color, &model);
+	}
+}
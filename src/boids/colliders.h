@@ -0,0 +1,84 @@
+#pragma once
+
+#include "boidskernel.h"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <vector>
+
+struct RenderApi3D;
+
+struct SphereCollider {
+	glm::vec3 center;
+	float radius;
+};
+
+// Sphere swept along the segment [a, b]
+struct CapsuleCollider {
+	glm::vec3 a;
+	glm::vec3 b;
+	float radius;
+};
+
+// Half space dot(normal, x) >= offset, normal is unit length
+struct PlaneCollider {
+	glm::vec3 normal;
+	float offset;
+};
+
+// Signed distance to a shape sampled on a regular grid: distances[(k * size.y + j) * size.x + i] at origin + cellSize * (i, j, k).
+// Particles sample it trilinearly, so they cost the same whatever the complexity of the shape. Outside of the grid they never collide.
+struct SdfGridCollider {
+	glm::vec3 origin = glm::vec3(0.f);
+	float cellSize = 1.f;
+	glm::ivec3 size = glm::ivec3(0);
+	std::vector<float> distances;
+	std::vector<glm::vec3> surfacePoints; // samples closer than half a cell to the surface, to draw it
+};
+
+// distance(position) must return the signed distance to the shape, negative inside
+template <typename Distance>
+void bakeSdfGridCollider(SdfGridCollider& grid, const glm::vec3& origin, float cellSize, const glm::ivec3& size, Distance distance) {
+	grid.origin = origin;
+	grid.cellSize = cellSize;
+	grid.size = size;
+	grid.distances.resize(size_t(size.x) * size.y * size.z);
+	grid.surfacePoints.clear();
+	for (int k = 0; k < size.z; k++) {
+		for (int j = 0; j < size.y; j++) {
+			for (int i = 0; i < size.x; i++) {
+				const glm::vec3 position = origin + cellSize * glm::vec3(i, j, k);
+				const float d = distance(position);
+				grid.distances[(size_t(k) * size.y + j) * size.x + i] = d;
+				if (glm::abs(d) < 0.5f * cellSize) {
+					grid.surfacePoints.push_back(position);
+				}
+			}
+		}
+	}
+}
+
+// Trilinear distance at position and its gradient, returns false outside of the grid
+bool sampleSdfGridCollider(const SdfGridCollider& grid, const glm::vec3& position, float& distance, glm::vec3& gradient);
+
+struct ColliderSet {
+	std::vector<SphereCollider> spheres;
+	std::vector<CapsuleCollider> capsules;
+	std::vector<PlaneCollider> planes;
+	std::vector<SdfGridCollider> sdfGrids;
+
+	bool empty() const { return spheres.empty() && capsules.empty() && planes.empty() && sdfGrids.empty(); }
+};
+
+// Particles are staged by batches of at most this count for collideParticleBatch, small enough to stay in the L1 cache
+constexpr size_t ColliderBatchSize = 256;
+
+// Moves the count particles x, y, z of the given radius out of every collider. Each collider is tested against the whole
+// batch before the next one, 8 particles at a time with AVX2 and 4 with SSE2, using masks instead of branches. SSE2 has no
+// gather, it samples the SDF grids one particle at a time. level must not be above detectSimdLevel().
+void collideParticleBatch(eSimdLevel level, const ColliderSet& colliders, float radius, float* x, float* y, float* z, size_t count);
+
+// Spheres and capsules are drawn solid, planes as a grid and SDF grids by their surface samples
+void drawColliders(const RenderApi3D& api, const ColliderSet& colliders, const glm::vec4& color);
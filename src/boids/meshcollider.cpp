@@ -0,0 +1,333 @@
+#include "meshcollider.h"
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace {
+	constexpr int BinCount = 12;
+	constexpr int MaxLeafSize = 8;
+	constexpr int MaxDepth = 64; // of the traversal stack, the build makes leaves past it
+
+	struct Bounds {
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+
+		void grow(const glm::vec3& point) {
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+
+		void grow(const Bounds& other) {
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		float halfArea() const {
+			const glm::vec3 extent = max - min;
+			return extent.x < 0.f ? 0.f : extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	struct BuildTask {
+		int node;
+		int first;
+		int count;
+		int depth;
+	};
+
+	// Closest point to p on the triangle abc, from Real-Time Collision Detection by Christer Ericson
+	glm::vec3 closestTrianglePoint(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		const glm::vec3 ab = b - a;
+		const glm::vec3 ac = c - a;
+		const glm::vec3 ap = p - a;
+		const float d1 = glm::dot(ab, ap);
+		const float d2 = glm::dot(ac, ap);
+		if (d1 <= 0.f && d2 <= 0.f) {
+			return a;
+		}
+
+		const glm::vec3 bp = p - b;
+		const float d3 = glm::dot(ab, bp);
+		const float d4 = glm::dot(ac, bp);
+		if (d3 >= 0.f && d4 <= d3) {
+			return b;
+		}
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+			return a + ab * (d1 / (d1 - d3));
+		}
+
+		const glm::vec3 cp = p - c;
+		const float d5 = glm::dot(ab, cp);
+		const float d6 = glm::dot(ac, cp);
+		if (d6 >= 0.f && d5 <= d6) {
+			return c;
+		}
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+			return a + ac * (d2 / (d2 - d6));
+		}
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		}
+
+		const float denominator = 1.f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	float distanceSqrToBounds(const glm::vec3& p, const MeshColliderNode& node) {
+		const glm::vec3 outside = glm::max(node.boundsMin - p, glm::vec3(0.f)) + glm::max(p - node.boundsMax, glm::vec3(0.f));
+		return glm::dot(outside, outside);
+	}
+
+	// Pushes position out of the triangle, returns true if it was closer than radius
+	bool collideTriangle(const MeshCollider& mesh, int triangle, float radius, glm::vec3& position) {
+		const glm::ivec3 indices = mesh.triangles[triangle];
+		const glm::vec3 a = mesh.vertices[indices.x];
+		const glm::vec3 b = mesh.vertices[indices.y];
+		const glm::vec3 c = mesh.vertices[indices.z];
+		const glm::vec3 closest = closestTrianglePoint(position, a, b, c);
+		const glm::vec3 offset = position - closest;
+		const float distanceSqr = glm::dot(offset, offset);
+		if (distanceSqr >= radius * radius) {
+			return false;
+		}
+
+		const glm::vec3 normal = glm::cross(b - a, c - a);
+		const float normalLength = glm::length(normal);
+		if (normalLength == 0.f) {
+			return false;
+		}
+		// behind the triangle or on it, the particle goes straight back to the front side of its plane: pushing it from
+		// the closest point would move it sideways when it projects onto a neighbour triangle
+		if (glm::dot(offset, normal) <= 0.f || distanceSqr == 0.f) {
+			const glm::vec3 unitNormal = normal / normalLength;
+			position += unitNormal * (radius - glm::dot(position - a, unitNormal));
+		}
+		else {
+			position = closest + offset * (radius / sqrtf(distanceSqr));
+		}
+		return true;
+	}
+}
+
+void buildMeshCollider(MeshCollider& mesh) {
+	const int triangleCount = int(mesh.triangles.size());
+	std::vector<Bounds> triangleBounds(triangleCount);
+	std::vector<glm::vec3> centroids(triangleCount);
+	for (int t = 0; t < triangleCount; t++) {
+		for (int i = 0; i < 3; i++) {
+			triangleBounds[t].grow(mesh.vertices[mesh.triangles[t][i]]);
+		}
+		centroids[t] = 0.5f * (triangleBounds[t].min + triangleBounds[t].max);
+	}
+
+	mesh.triangleIndices.resize(triangleCount);
+	for (int t = 0; t < triangleCount; t++) {
+		mesh.triangleIndices[t] = t;
+	}
+	mesh.nodes.clear();
+	if (triangleCount == 0) {
+		return;
+	}
+	mesh.nodes.reserve(2 * (triangleCount / (MaxLeafSize / 2) + 1));
+	mesh.nodes.emplace_back();
+
+	std::vector<BuildTask> tasks = { { 0, 0, triangleCount, 0 } };
+	while (!tasks.empty()) {
+		const BuildTask task = tasks.back();
+		tasks.pop_back();
+		int* indices = mesh.triangleIndices.data() + task.first;
+
+		Bounds bounds;
+		Bounds centroidBounds;
+		for (int i = 0; i < task.count; i++) {
+			bounds.grow(triangleBounds[indices[i]]);
+			centroidBounds.grow(centroids[indices[i]]);
+		}
+		mesh.nodes[task.node].boundsMin = bounds.min;
+		mesh.nodes[task.node].boundsMax = bounds.max;
+		mesh.nodes[task.node].first = task.first;
+		mesh.nodes[task.node].triangleCount = task.count;
+		if (task.count <= 2 || task.depth >= MaxDepth - 2) {
+			continue;
+		}
+
+		// best split over the bins of the 3 axes
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		int bestSplit = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			if (extent <= 0.f) {
+				continue;
+			}
+			const float binScale = BinCount / extent;
+
+			Bounds binBounds[BinCount];
+			int binCounts[BinCount] = {};
+			for (int i = 0; i < task.count; i++) {
+				const int bin = glm::min(int((centroids[indices[i]][axis] - centroidBounds.min[axis]) * binScale), BinCount - 1);
+				binBounds[bin].grow(triangleBounds[indices[i]]);
+				binCounts[bin]++;
+			}
+
+			// areas of everything left of each boundary, then swept from the right
+			float leftAreas[BinCount - 1];
+			int leftCounts[BinCount - 1];
+			Bounds left;
+			int leftCount = 0;
+			for (int b = 0; b < BinCount - 1; b++) {
+				left.grow(binBounds[b]);
+				leftCount += binCounts[b];
+				leftAreas[b] = left.halfArea();
+				leftCounts[b] = leftCount;
+			}
+			Bounds right;
+			int rightCount = 0;
+			for (int b = BinCount - 1; b > 0; b--) {
+				right.grow(binBounds[b]);
+				rightCount += binCounts[b];
+				const float cost = leftAreas[b - 1] * leftCounts[b - 1] + right.halfArea() * rightCount;
+				if (leftCounts[b - 1] > 0 && rightCount > 0 && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+
+		// a leaf costs intersecting all of its triangles, a traversal step is about as expensive as a triangle test
+		const float leafCost = bounds.halfArea() * task.count;
+		if (bestAxis < 0 || (bestCost + bounds.halfArea() >= leafCost && task.count <= MaxLeafSize)) {
+			continue;
+		}
+
+		const float binScale = BinCount / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+		int* middle = std::partition(indices, indices + task.count, [&](int t) {
+			return glm::min(int((centroids[t][bestAxis] - centroidBounds.min[bestAxis]) * binScale), BinCount - 1) < bestSplit;
+		});
+		const int leftCount = int(middle - indices);
+
+		const int leftNode = int(mesh.nodes.size());
+		mesh.nodes.emplace_back();
+		mesh.nodes.emplace_back();
+		mesh.nodes[task.node].first = leftNode;
+		mesh.nodes[task.node].triangleCount = 0;
+		tasks.push_back({ leftNode, task.first, leftCount, task.depth + 1 });
+		tasks.push_back({ leftNode + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+	}
+}
+
+void refitMeshCollider(MeshCollider& mesh) {
+	for (size_t n = mesh.nodes.size(); n-- > 0; ) {
+		MeshColliderNode& node = mesh.nodes[n];
+		Bounds bounds;
+		if (node.triangleCount > 0) {
+			for (int i = node.first; i < node.first + node.triangleCount; i++) {
+				const glm::ivec3 triangle = mesh.triangles[mesh.triangleIndices[i]];
+				bounds.grow(mesh.vertices[triangle.x]);
+				bounds.grow(mesh.vertices[triangle.y]);
+				bounds.grow(mesh.vertices[triangle.z]);
+			}
+		}
+		else {
+			const MeshColliderNode& left = mesh.nodes[node.first];
+			const MeshColliderNode& right = mesh.nodes[node.first + 1];
+			bounds.min = glm::min(left.boundsMin, right.boundsMin);
+			bounds.max = glm::max(left.boundsMax, right.boundsMax);
+		}
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+	}
+}
+
+size_t collideMeshColliderBatch(const MeshCollider& mesh, float radius, float* x, float* y, float* z, size_t count) {
+	if (mesh.empty()) {
+		return 0;
+	}
+
+	size_t testedTriangleCount = 0;
+	int stack[MaxDepth];
+	for (size_t i = 0; i < count; i++) {
+		glm::vec3 position = glm::vec3(x[i], y[i], z[i]);
+		const float radiusSqr = radius * radius;
+
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const MeshColliderNode& node = mesh.nodes[stack[--stackSize]];
+			if (distanceSqrToBounds(position, node) >= radiusSqr) {
+				continue;
+			}
+			if (node.triangleCount > 0) {
+				for (int t = node.first; t < node.first + node.triangleCount; t++) {
+					collideTriangle(mesh, mesh.triangleIndices[t], radius, position);
+				}
+				testedTriangleCount += node.triangleCount;
+			}
+			else {
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+
+		x[i] = position.x;
+		y[i] = position.y;
+		z[i] = position.z;
+	}
+	return testedTriangleCount;
+}
+
+void computeMeshColliderNormals(const MeshCollider& mesh, std::vector<glm::vec3>& normals) {
+	normals.assign(mesh.vertices.size(), glm::vec3(0.f));
+	for (const glm::ivec3& triangle : mesh.triangles) {
+		const glm::vec3 p0 = mesh.vertices[triangle.x];
+		const glm::vec3 normal = glm::cross(mesh.vertices[triangle.y] - p0, mesh.vertices[triangle.z] - p0);
+		normals[triangle.x] += normal;
+		normals[triangle.y] += normal;
+		normals[triangle.z] += normal;
+	}
+	for (glm::vec3& normal : normals) {
+		const float length = glm::length(normal);
+		normal = length > 0.f ? normal / length : glm::vec3(0.f, 1.f, 0.f);
+	}
+}
+
+void makeWavyMeshCollider(MeshCollider& mesh, const glm::vec3& center, float size, int resolution, float amplitude, float time) {
+	const int rowSize = resolution + 1;
+	if (mesh.vertices.size() != size_t(rowSize) * rowSize) {
+		mesh.vertices.resize(size_t(rowSize) * rowSize);
+		mesh.triangles.clear();
+		mesh.triangles.reserve(2 * size_t(resolution) * resolution);
+		for (int j = 0; j < resolution; j++) {
+			for (int i = 0; i < resolution; i++) {
+				const int v00 = j * rowSize + i;
+				const int v10 = v00 + 1;
+				const int v01 = v00 + rowSize;
+				const int v11 = v01 + 1;
+				// counterclockwise seen from above, the front side faces +y
+				mesh.triangles.push_back(glm::ivec3(v00, v01, v11));
+				mesh.triangles.push_back(glm::ivec3(v00, v11, v10));
+			}
+		}
+		mesh.nodes.clear();
+	}
+
+	const float cellSize = size / resolution;
+	for (int j = 0; j < rowSize; j++) {
+		for (int i = 0; i < rowSize; i++) {
+			const float u = i * cellSize - 0.5f * size;
+			const float v = j * cellSize - 0.5f * size;
+			const float wave = amplitude * sinf(1.3f * u + time) * cosf(1.1f * v + 0.7f * time);
+			mesh.vertices[j * rowSize + i] = center + glm::vec3(u, wave, v);
+		}
+	}
+}
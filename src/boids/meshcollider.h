@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+// Node of the bounding volume hierarchy of a MeshCollider, 32 bytes so that two of them fill a cache line
+struct MeshColliderNode {
+	glm::vec3 boundsMin;
+	int first; // index of the left child, the right one follows it, or of the first triangle of a leaf in triangleIndices
+	glm::vec3 boundsMax;
+	int triangleCount; // 0 for an inner node
+};
+
+// Triangle mesh that particles collide with, one sided: a particle closer than its radius to a triangle is pushed
+// to the front side of it, the side its counterclockwise vertices face. When the vertices move but the triangles
+// stay the same, refitMeshCollider updates the bounds of the hierarchy without rebuilding it.
+struct MeshCollider {
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::ivec3> triangles;
+	std::vector<int> triangleIndices; // triangles of every leaf, contiguous
+	std::vector<MeshColliderNode> nodes; // nodes[0] is the root, children are always stored after their parent
+
+	bool empty() const { return nodes.empty(); }
+};
+
+// Binned surface area heuristic: every node is split at the bin boundary that minimizes the summed areas of the
+// children weighted by their triangle counts, or becomes a leaf when no split is cheaper than intersecting its triangles
+void buildMeshCollider(MeshCollider& mesh);
+
+// Recomputes the bounds of every node from the current vertices, children before parents
+void refitMeshCollider(MeshCollider& mesh);
+
+// Moves the count particles x, y, z of the given radius out of the triangles of mesh, one hierarchy traversal per particle.
+// Returns the number of triangles the particles were tested against.
+size_t collideMeshColliderBatch(const MeshCollider& mesh, float radius, float* x, float* y, float* z, size_t count);
+
+// Area weighted normal of every vertex, to draw the mesh
+void computeMeshColliderNormals(const MeshCollider& mesh, std::vector<glm::vec3>& normals);
+
+// Grid of resolution x resolution quads centered on center in the xz plane, displaced along y by waves of the given amplitude
+// moving with time. The triangles are only created when the resolution changes, call refitMeshCollider afterwards.
+void makeWavyMeshCollider(MeshCollider& mesh, const glm::vec3& center, float size, int resolution, float amplitude, float time);
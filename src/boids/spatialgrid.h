@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/common.hpp>
+#include <vector>
+#include <assert.h>
+#include <stdint.h>
+
+// Uniform grid stored as a spatial hash: points are counting-sorted by cell so that
+// every cell is a contiguous range of cellEntries. Rebuild it every step, then gather
+// the candidates around a position instead of scanning every point.
+struct SpatialGrid
+{
+	float cellSize = 1.f;
+	float invCellSize = 1.f;
+	unsigned int tableSize = 0;
+
+	std::vector<int> cellStart; // tableSize + 1 offsets into cellEntries
+	std::vector<int> cellEntries; // point indices sorted by cell
+	std::vector<unsigned int> pointCell; // cell hash of each point, filled by build()
+
+	glm::ivec3 cellCoord(const glm::vec3& position) const
+	{
+		return glm::ivec3(glm::floor(position * invCellSize));
+	}
+
+	unsigned int hashCell(const glm::ivec3& cell) const
+	{
+		// unsigned, so that the products wrap instead of overflowing
+		const uint32_t h = (uint32_t(cell.x) * 92837111u) ^ (uint32_t(cell.y) * 689287499u) ^ (uint32_t(cell.z) * 283923481u);
+		return h & (tableSize - 1);
+	}
+
+	// getPosition(i) must return the glm::vec3 position of point i
+	template <typename GetPosition>
+	void build(size_t pointCount, float newCellSize, GetPosition getPosition)
+	{
+		cellSize = glm::max(newCellSize, 1e-3f);
+		invCellSize = 1.f / cellSize;
+
+		tableSize = 64;
+		while (tableSize < 2 * pointCount)
+		{
+			tableSize <<= 1;
+		}
+
+		cellStart.assign(tableSize + 1, 0);
+		cellEntries.resize(pointCount);
+		pointCell.resize(pointCount);
+
+		for (size_t i = 0; i < pointCount; i++)
+		{
+			pointCell[i] = hashCell(cellCoord(getPosition(i)));
+			cellStart[pointCell[i]]++;
+		}
+
+		// inclusive prefix sum gives the end of each cell, filling backwards leaves cellStart at the start of each cell
+		int start = 0;
+		for (unsigned int c = 0; c <= tableSize; c++)
+		{
+			start += cellStart[c];
+			cellStart[c] = start;
+		}
+		for (size_t i = pointCount; i-- > 0; )
+		{
+			cellEntries[--cellStart[pointCell[i]]] = int(i);
+		}
+	}
+
+	// Appends to candidates every point stored in the cells overlapping the box [position - radius, position + radius].
+	// Candidates still have to be distance tested. Returns the number of appended candidates.
+	size_t gather(const glm::vec3& position, float radius, std::vector<int>& candidates) const
+	{
+		assert(radius <= cellSize); // at most 3x3x3 cells are visited
+		const size_t firstCandidate = candidates.size();
+		const glm::ivec3 minCell = cellCoord(position - glm::vec3(radius));
+		const glm::ivec3 maxCell = cellCoord(position + glm::vec3(radius));
+
+		// distinct cells may share a bucket, never visit a bucket twice
+		unsigned int visited[27];
+		int visitedCount = 0;
+
+		for (int x = minCell.x; x <= maxCell.x; x++)
+		{
+			for (int y = minCell.y; y <= maxCell.y; y++)
+			{
+				for (int z = minCell.z; z <= maxCell.z; z++)
+				{
+					const unsigned int bucket = hashCell(glm::ivec3(x, y, z));
+					if (cellStart[bucket] == cellStart[bucket + 1])
+					{
+						continue;
+					}
+
+					bool alreadyVisited = false;
+					for (int v = 0; v < visitedCount && !alreadyVisited; v++)
+					{
+						alreadyVisited = visited[v] == bucket;
+					}
+					if (alreadyVisited)
+					{
+						continue;
+					}
+					if (visitedCount < 27)
+					{
+						visited[visitedCount++] = bucket;
+					}
+
+					candidates.insert(candidates.end(), cellEntries.begin() + cellStart[bucket], cellEntries.begin() + cellStart[bucket + 1]);
+				}
+			}
+		}
+
+		return candidates.size() - firstCandidate;
+	}
+};
@@ -0,0 +1,345 @@
+#include "wind.h"
+
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WIND_KERNEL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define WIND_TARGET_AVX2
+#else
+#define WIND_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define WIND_KERNEL_X86 0
+#endif
+
+namespace {
+	// Pseudo random value in [-1, 1] at a lattice point, one sequence per seed
+	float latticeValue(int i, int j, int k, uint32_t seed) {
+		uint32_t hash = (uint32_t(i) * 73856093u) ^ (uint32_t(j) * 19349663u) ^ (uint32_t(k) * 83492791u) ^ seed;
+		hash ^= hash >> 13;
+		hash *= 0x5bd1e995u;
+		hash ^= hash >> 15;
+		return float(hash & 0xffffffu) * (2.f / float(0xffffff)) - 1.f;
+	}
+
+	float valueNoise(const glm::vec3& position, uint32_t seed) {
+		const glm::vec3 cornerPosition = glm::floor(position);
+		const glm::ivec3 corner = glm::ivec3(cornerPosition);
+		const glm::vec3 t = position - cornerPosition;
+		const glm::vec3 weight = t * t * (3.f - 2.f * t); // smoothstep, so that the noise has no creases on the lattice
+
+		const float v00 = glm::mix(latticeValue(corner.x, corner.y, corner.z, seed), latticeValue(corner.x + 1, corner.y, corner.z, seed), weight.x);
+		const float v10 = glm::mix(latticeValue(corner.x, corner.y + 1, corner.z, seed), latticeValue(corner.x + 1, corner.y + 1, corner.z, seed), weight.x);
+		const float v01 = glm::mix(latticeValue(corner.x, corner.y, corner.z + 1, seed), latticeValue(corner.x + 1, corner.y, corner.z + 1, seed), weight.x);
+		const float v11 = glm::mix(latticeValue(corner.x, corner.y + 1, corner.z + 1, seed), latticeValue(corner.x + 1, corner.y + 1, corner.z + 1, seed), weight.x);
+		return glm::mix(glm::mix(v00, v10, weight.y), glm::mix(v01, v11, weight.y), weight.z);
+	}
+
+	glm::vec3 sampleWindField(const WindField& field, const glm::vec3& position) {
+		const float maxCell = float(field.resolution - 2);
+		const glm::vec3 local = glm::clamp((position - field.origin) / field.cellSize, glm::vec3(0.f), glm::vec3(float(field.resolution - 1)));
+		const glm::vec3 cellCorner = glm::min(glm::floor(local), glm::vec3(maxCell));
+		const glm::vec3 t = local - cellCorner;
+		const size_t strideY = size_t(field.resolution);
+		const size_t strideZ = strideY * field.resolution;
+		const size_t index = size_t(cellCorner.z) * strideZ + size_t(cellCorner.y) * strideY + size_t(cellCorner.x);
+
+		glm::vec3 sample;
+		const std::vector<float>* channels[3] = { &field.x, &field.y, &field.z };
+		for (int c = 0; c < 3; c++) {
+			const float* v = channels[c]->data() + index;
+			const float v00 = glm::mix(v[0], v[1], t.x);
+			const float v10 = glm::mix(v[strideY], v[strideY + 1], t.x);
+			const float v01 = glm::mix(v[strideZ], v[strideZ + 1], t.x);
+			const float v11 = glm::mix(v[strideZ + strideY], v[strideZ + strideY + 1], t.x);
+			sample[c] = glm::mix(glm::mix(v00, v10, t.y), glm::mix(v01, v11, t.y), t.z);
+		}
+		return sample;
+	}
+
+	glm::vec3 aerodynamicForce(const WindField& field, const AerodynamicParameters& parameters, const glm::vec3* positions, const glm::vec3* oldPositions, const glm::ivec3& triangle) {
+		const glm::vec3 p0 = positions[triangle.x];
+		const glm::vec3 p1 = positions[triangle.y];
+		const glm::vec3 p2 = positions[triangle.z];
+		const glm::vec3 centroid = (p0 + p1 + p2) * (1.f / 3.f);
+		const glm::vec3 move = (p0 - oldPositions[triangle.x]) + (p1 - oldPositions[triangle.y]) + (p2 - oldPositions[triangle.z]);
+		const glm::vec3 velocity = move * (parameters.inverseStepSize / 3.f);
+		const glm::vec3 relativeVelocity = parameters.wind + parameters.turbulence * sampleWindField(field, centroid) - velocity;
+
+		// |normal| is twice the area, area * dot(n, v) * n = 0.5 * dot(normal, v) * normal / |normal|
+		const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const float normalLength = glm::length(normal);
+		if (normalLength == 0.f) {
+			return glm::vec3(0.f);
+		}
+		return normal * (0.5f * parameters.drag * glm::dot(normal, relativeVelocity) / normalLength);
+	}
+
+	void computeScalar(const WindField& field, const AerodynamicParameters& parameters, const glm::vec3* positions, const glm::vec3* oldPositions,
+		const glm::ivec3* triangles, size_t begin, size_t end, float* forceX, float* forceY, float* forceZ) {
+		for (size_t t = begin; t < end; t++) {
+			const glm::vec3 force = aerodynamicForce(field, parameters, positions, oldPositions, triangles[t]);
+			forceX[t] = force.x;
+			forceY[t] = force.y;
+			forceZ[t] = force.z;
+		}
+	}
+
+#if WIND_KERNEL_X86
+	// a + t * (b - a)
+	__m128 lerpSSE2(__m128 a, __m128 b, __m128 t) {
+		return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+	}
+
+	// Trilinear interpolation of the 3 channels at 4 positions, only the loads of the cell corners are scalar
+	void sampleWindFieldSSE2(const WindField& field, __m128 px, __m128 py, __m128 pz, __m128& sx, __m128& sy, __m128& sz) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 invCellSize = _mm_set1_ps(1.f / field.cellSize);
+		const __m128 maxCoordinate = _mm_set1_ps(float(field.resolution - 1));
+		const __m128 maxCell = _mm_set1_ps(float(field.resolution - 2));
+		const __m128 localX = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(px, _mm_set1_ps(field.origin.x)), invCellSize), zero), maxCoordinate);
+		const __m128 localY = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(py, _mm_set1_ps(field.origin.y)), invCellSize), zero), maxCoordinate);
+		const __m128 localZ = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(pz, _mm_set1_ps(field.origin.z)), invCellSize), zero), maxCoordinate);
+		// the coordinates are positive, truncating them is flooring them
+		const __m128i cellX = _mm_cvttps_epi32(_mm_min_ps(localX, maxCell));
+		const __m128i cellY = _mm_cvttps_epi32(_mm_min_ps(localY, maxCell));
+		const __m128i cellZ = _mm_cvttps_epi32(_mm_min_ps(localZ, maxCell));
+		const __m128 tx = _mm_sub_ps(localX, _mm_cvtepi32_ps(cellX));
+		const __m128 ty = _mm_sub_ps(localY, _mm_cvtepi32_ps(cellY));
+		const __m128 tz = _mm_sub_ps(localZ, _mm_cvtepi32_ps(cellZ));
+
+		alignas(16) int cells[3][4];
+		_mm_store_si128((__m128i*)cells[0], cellX);
+		_mm_store_si128((__m128i*)cells[1], cellY);
+		_mm_store_si128((__m128i*)cells[2], cellZ);
+		const size_t strideY = size_t(field.resolution);
+		const size_t strideZ = strideY * field.resolution;
+		size_t indices[4];
+		for (int l = 0; l < 4; l++) {
+			indices[l] = size_t(cells[2][l]) * strideZ + size_t(cells[1][l]) * strideY + size_t(cells[0][l]);
+		}
+
+		const size_t cornerOffsets[8] = { 0, 1, strideY, strideY + 1, strideZ, strideZ + 1, strideZ + strideY, strideZ + strideY + 1 };
+		const std::vector<float>* channels[3] = { &field.x, &field.y, &field.z };
+		__m128* samples[3] = { &sx, &sy, &sz };
+		for (int c = 0; c < 3; c++) {
+			const float* v = channels[c]->data();
+			__m128 corners[8];
+			for (int corner = 0; corner < 8; corner++) {
+				const size_t offset = cornerOffsets[corner];
+				corners[corner] = _mm_setr_ps(v[indices[0] + offset], v[indices[1] + offset], v[indices[2] + offset], v[indices[3] + offset]);
+			}
+			const __m128 v00 = lerpSSE2(corners[0], corners[1], tx);
+			const __m128 v10 = lerpSSE2(corners[2], corners[3], tx);
+			const __m128 v01 = lerpSSE2(corners[4], corners[5], tx);
+			const __m128 v11 = lerpSSE2(corners[6], corners[7], tx);
+			*samples[c] = lerpSSE2(lerpSSE2(v00, v10, ty), lerpSSE2(v01, v11, ty), tz);
+		}
+	}
+
+	// SSE2 has no gather, the vertices and the field samples are loaded one triangle at a time, the rest runs on 4 lanes.
+	// Returns the index of the first triangle left to the scalar loop.
+	size_t computeSSE2(const WindField& field, const AerodynamicParameters& parameters, const glm::vec3* positions, const glm::vec3* oldPositions,
+		const glm::ivec3* triangles, size_t begin, size_t end, float* forceX, float* forceY, float* forceZ) {
+		const __m128 third = _mm_set1_ps(1.f / 3.f);
+		const __m128 velocityScale = _mm_set1_ps(parameters.inverseStepSize / 3.f);
+		const __m128 turbulence = _mm_set1_ps(parameters.turbulence);
+		const __m128 windX = _mm_set1_ps(parameters.wind.x), windY = _mm_set1_ps(parameters.wind.y), windZ = _mm_set1_ps(parameters.wind.z);
+		const __m128 halfDrag = _mm_set1_ps(0.5f * parameters.drag);
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t t = begin;
+		for (; t + 4 <= end; t += 4) {
+			// vertex v of lane l is at [v][l], the move is summed over the vertices
+			alignas(16) float px[3][4], py[3][4], pz[3][4];
+			alignas(16) float mx[4], my[4], mz[4];
+			for (int l = 0; l < 4; l++) {
+				const glm::ivec3 triangle = triangles[t + l];
+				glm::vec3 move = glm::vec3(0.f);
+				for (int v = 0; v < 3; v++) {
+					const glm::vec3 position = positions[triangle[v]];
+					px[v][l] = position.x;
+					py[v][l] = position.y;
+					pz[v][l] = position.z;
+					move += position - oldPositions[triangle[v]];
+				}
+				mx[l] = move.x;
+				my[l] = move.y;
+				mz[l] = move.z;
+			}
+
+			const __m128 p0x = _mm_load_ps(px[0]), p0y = _mm_load_ps(py[0]), p0z = _mm_load_ps(pz[0]);
+			const __m128 p1x = _mm_load_ps(px[1]), p1y = _mm_load_ps(py[1]), p1z = _mm_load_ps(pz[1]);
+			const __m128 p2x = _mm_load_ps(px[2]), p2y = _mm_load_ps(py[2]), p2z = _mm_load_ps(pz[2]);
+			__m128 sx, sy, sz;
+			sampleWindFieldSSE2(field, _mm_mul_ps(_mm_add_ps(_mm_add_ps(p0x, p1x), p2x), third), _mm_mul_ps(_mm_add_ps(_mm_add_ps(p0y, p1y), p2y), third),
+				_mm_mul_ps(_mm_add_ps(_mm_add_ps(p0z, p1z), p2z), third), sx, sy, sz);
+
+			const __m128 e1x = _mm_sub_ps(p1x, p0x), e1y = _mm_sub_ps(p1y, p0y), e1z = _mm_sub_ps(p1z, p0z);
+			const __m128 e2x = _mm_sub_ps(p2x, p0x), e2y = _mm_sub_ps(p2y, p0y), e2z = _mm_sub_ps(p2z, p0z);
+			const __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+			const __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+			const __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+
+			const __m128 rx = _mm_sub_ps(_mm_add_ps(windX, _mm_mul_ps(turbulence, sx)), _mm_mul_ps(_mm_load_ps(mx), velocityScale));
+			const __m128 ry = _mm_sub_ps(_mm_add_ps(windY, _mm_mul_ps(turbulence, sy)), _mm_mul_ps(_mm_load_ps(my), velocityScale));
+			const __m128 rz = _mm_sub_ps(_mm_add_ps(windZ, _mm_mul_ps(turbulence, sz)), _mm_mul_ps(_mm_load_ps(mz), velocityScale));
+
+			const __m128 normalLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+			const __m128 normalVelocity = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, rx), _mm_mul_ps(ny, ry)), _mm_mul_ps(nz, rz));
+			const __m128 degenerate = _mm_cmpeq_ps(normalLength, zero);
+			const __m128 scale = _mm_andnot_ps(degenerate, _mm_div_ps(_mm_mul_ps(halfDrag, normalVelocity), _mm_or_ps(normalLength, _mm_and_ps(degenerate, third))));
+			_mm_storeu_ps(forceX + t, _mm_mul_ps(nx, scale));
+			_mm_storeu_ps(forceY + t, _mm_mul_ps(ny, scale));
+			_mm_storeu_ps(forceZ + t, _mm_mul_ps(nz, scale));
+		}
+		return t;
+	}
+
+	WIND_TARGET_AVX2 __m256 lerpAVX2(__m256 a, __m256 b, __m256 t) {
+		return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+	}
+
+	// Trilinear interpolation of one channel at the 8 cells starting at index000
+	WIND_TARGET_AVX2 __m256 sampleChannelAVX2(const float* channel, __m256i index000, __m256i strideY, __m256i strideZ, __m256 tx, __m256 ty, __m256 tz) {
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i index010 = _mm256_add_epi32(index000, strideY);
+		const __m256i index001 = _mm256_add_epi32(index000, strideZ);
+		const __m256i index011 = _mm256_add_epi32(index010, strideZ);
+		const __m256 v00 = lerpAVX2(_mm256_i32gather_ps(channel, index000, 4), _mm256_i32gather_ps(channel, _mm256_add_epi32(index000, one), 4), tx);
+		const __m256 v10 = lerpAVX2(_mm256_i32gather_ps(channel, index010, 4), _mm256_i32gather_ps(channel, _mm256_add_epi32(index010, one), 4), tx);
+		const __m256 v01 = lerpAVX2(_mm256_i32gather_ps(channel, index001, 4), _mm256_i32gather_ps(channel, _mm256_add_epi32(index001, one), 4), tx);
+		const __m256 v11 = lerpAVX2(_mm256_i32gather_ps(channel, index011, 4), _mm256_i32gather_ps(channel, _mm256_add_epi32(index011, one), 4), tx);
+		return lerpAVX2(lerpAVX2(v00, v10, ty), lerpAVX2(v01, v11, ty), tz);
+	}
+
+	// The vertex indices, the positions and the field samples are all gathered, 8 triangles at a time
+	WIND_TARGET_AVX2 size_t computeAVX2(const WindField& field, const AerodynamicParameters& parameters, const glm::vec3* positions, const glm::vec3* oldPositions,
+		const glm::ivec3* triangles, size_t begin, size_t end, float* forceX, float* forceY, float* forceZ) {
+		const int* triangleIndices = &triangles[0].x;
+		const float* position = &positions[0].x;
+		const float* oldPosition = &oldPositions[0].x;
+		const __m256i laneOffsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+		const __m256i three = _mm256_set1_epi32(3);
+
+		const __m256 third = _mm256_set1_ps(1.f / 3.f);
+		const __m256 velocityScale = _mm256_set1_ps(parameters.inverseStepSize / 3.f);
+		const __m256 turbulence = _mm256_set1_ps(parameters.turbulence);
+		const __m256 windX = _mm256_set1_ps(parameters.wind.x), windY = _mm256_set1_ps(parameters.wind.y), windZ = _mm256_set1_ps(parameters.wind.z);
+		const __m256 halfDrag = _mm256_set1_ps(0.5f * parameters.drag);
+		const __m256 zero = _mm256_setzero_ps();
+
+		const __m256 originX = _mm256_set1_ps(field.origin.x), originY = _mm256_set1_ps(field.origin.y), originZ = _mm256_set1_ps(field.origin.z);
+		const __m256 invCellSize = _mm256_set1_ps(1.f / field.cellSize);
+		const __m256 maxCoordinate = _mm256_set1_ps(float(field.resolution - 1));
+		const __m256 maxCell = _mm256_set1_ps(float(field.resolution - 2));
+		const __m256i strideY = _mm256_set1_epi32(field.resolution);
+		const __m256i strideZ = _mm256_set1_epi32(field.resolution * field.resolution);
+
+		size_t t = begin;
+		for (; t + 8 <= end; t += 8) {
+			const __m256i triangleOffsets = _mm256_add_epi32(laneOffsets, _mm256_set1_epi32(int(3 * t)));
+			__m256 px[3], py[3], pz[3];
+			__m256 mx = zero, my = zero, mz = zero;
+			for (int v = 0; v < 3; v++) {
+				const __m256i vertexOffsets = _mm256_mullo_epi32(_mm256_i32gather_epi32(triangleIndices + v, triangleOffsets, 4), three);
+				px[v] = _mm256_i32gather_ps(position, vertexOffsets, 4);
+				py[v] = _mm256_i32gather_ps(position + 1, vertexOffsets, 4);
+				pz[v] = _mm256_i32gather_ps(position + 2, vertexOffsets, 4);
+				mx = _mm256_add_ps(mx, _mm256_sub_ps(px[v], _mm256_i32gather_ps(oldPosition, vertexOffsets, 4)));
+				my = _mm256_add_ps(my, _mm256_sub_ps(py[v], _mm256_i32gather_ps(oldPosition + 1, vertexOffsets, 4)));
+				mz = _mm256_add_ps(mz, _mm256_sub_ps(pz[v], _mm256_i32gather_ps(oldPosition + 2, vertexOffsets, 4)));
+			}
+
+			// the centroids are clamped into the field, as in sampleWindField
+			const __m256 cx = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(px[0], px[1]), px[2]), third);
+			const __m256 cy = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(py[0], py[1]), py[2]), third);
+			const __m256 cz = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(pz[0], pz[1]), pz[2]), third);
+			const __m256 localX = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(cx, originX), invCellSize), zero), maxCoordinate);
+			const __m256 localY = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(cy, originY), invCellSize), zero), maxCoordinate);
+			const __m256 localZ = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(cz, originZ), invCellSize), zero), maxCoordinate);
+			const __m256 cellX = _mm256_min_ps(_mm256_floor_ps(localX), maxCell);
+			const __m256 cellY = _mm256_min_ps(_mm256_floor_ps(localY), maxCell);
+			const __m256 cellZ = _mm256_min_ps(_mm256_floor_ps(localZ), maxCell);
+			const __m256i index000 = _mm256_add_epi32(
+				_mm256_add_epi32(_mm256_cvttps_epi32(cellX), _mm256_mullo_epi32(_mm256_cvttps_epi32(cellY), strideY)),
+				_mm256_mullo_epi32(_mm256_cvttps_epi32(cellZ), strideZ));
+			const __m256 tx = _mm256_sub_ps(localX, cellX), ty = _mm256_sub_ps(localY, cellY), tz = _mm256_sub_ps(localZ, cellZ);
+			const __m256 sx = sampleChannelAVX2(field.x.data(), index000, strideY, strideZ, tx, ty, tz);
+			const __m256 sy = sampleChannelAVX2(field.y.data(), index000, strideY, strideZ, tx, ty, tz);
+			const __m256 sz = sampleChannelAVX2(field.z.data(), index000, strideY, strideZ, tx, ty, tz);
+
+			const __m256 e1x = _mm256_sub_ps(px[1], px[0]), e1y = _mm256_sub_ps(py[1], py[0]), e1z = _mm256_sub_ps(pz[1], pz[0]);
+			const __m256 e2x = _mm256_sub_ps(px[2], px[0]), e2y = _mm256_sub_ps(py[2], py[0]), e2z = _mm256_sub_ps(pz[2], pz[0]);
+			const __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e1z, e2y));
+			const __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e1x, e2z));
+			const __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e1y, e2x));
+
+			const __m256 rx = _mm256_sub_ps(_mm256_add_ps(windX, _mm256_mul_ps(turbulence, sx)), _mm256_mul_ps(mx, velocityScale));
+			const __m256 ry = _mm256_sub_ps(_mm256_add_ps(windY, _mm256_mul_ps(turbulence, sy)), _mm256_mul_ps(my, velocityScale));
+			const __m256 rz = _mm256_sub_ps(_mm256_add_ps(windZ, _mm256_mul_ps(turbulence, sz)), _mm256_mul_ps(mz, velocityScale));
+
+			const __m256 normalLength = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+			const __m256 normalVelocity = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, rx), _mm256_mul_ps(ny, ry)), _mm256_mul_ps(nz, rz));
+			// degenerate triangles divide by 1/3 instead of 0, then their force is masked out
+			const __m256 degenerate = _mm256_cmp_ps(normalLength, zero, _CMP_EQ_OQ);
+			const __m256 scale = _mm256_andnot_ps(degenerate, _mm256_div_ps(_mm256_mul_ps(halfDrag, normalVelocity), _mm256_or_ps(normalLength, _mm256_and_ps(degenerate, third))));
+			_mm256_storeu_ps(forceX + t, _mm256_mul_ps(nx, scale));
+			_mm256_storeu_ps(forceY + t, _mm256_mul_ps(ny, scale));
+			_mm256_storeu_ps(forceZ + t, _mm256_mul_ps(nz, scale));
+		}
+		return t;
+	}
+#endif
+}
+
+void resizeWindField(WindField& field, const glm::vec3& boundsMin, const glm::vec3& boundsMax, int resolution) {
+	assert(resolution >= 2);
+	const glm::vec3 extent = boundsMax - boundsMin;
+	const float size = glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-3f));
+	field.origin = boundsMin;
+	field.cellSize = size / float(resolution - 1);
+	field.resolution = resolution;
+	const size_t sampleCount = size_t(resolution) * resolution * resolution;
+	field.x.resize(sampleCount);
+	field.y.resize(sampleCount);
+	field.z.resize(sampleCount);
+}
+
+void bakeWindFieldSlices(WindField& field, float frequency, const glm::vec3& offset, size_t sliceBegin, size_t sliceEnd) {
+	const int resolution = field.resolution;
+	for (size_t k = sliceBegin; k < sliceEnd; k++) {
+		for (int j = 0; j < resolution; j++) {
+			for (int i = 0; i < resolution; i++) {
+				const glm::vec3 position = (field.origin + field.cellSize * glm::vec3(float(i), float(j), float(k))) * frequency + offset;
+				const size_t index = (k * resolution + j) * resolution + i;
+				field.x[index] = valueNoise(position, 0x9e3779b9u);
+				field.y[index] = valueNoise(position, 0x85ebca6bu);
+				field.z[index] = valueNoise(position, 0xc2b2ae35u);
+			}
+		}
+	}
+}
+
+void computeAerodynamicForces(eSimdLevel level, const WindField& field, const AerodynamicParameters& parameters, const glm::vec3* positions,
+	const glm::vec3* oldPositions, const glm::ivec3* triangles, size_t begin, size_t end, float* forceX, float* forceY, float* forceZ) {
+	assert(level <= detectSimdLevel()); // the cpu can't run this kernel
+	assert(field.resolution >= 2);
+
+	size_t t = begin;
+#if WIND_KERNEL_X86
+	if (level == eSimdLevel::AVX2) {
+		t = computeAVX2(field, parameters, positions, oldPositions, triangles, begin, end, forceX, forceY, forceZ);
+	}
+	else if (level == eSimdLevel::SSE2) {
+		t = computeSSE2(field, parameters, positions, oldPositions, triangles, begin, end, forceX, forceY, forceZ);
+	}
+#endif
+	computeScalar(field, parameters, positions, oldPositions, triangles, t, end, forceX, forceY, forceZ);
+}
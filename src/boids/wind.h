@@ -0,0 +1,36 @@
+#pragma once
+
+#include "boidskernel.h"
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+// Turbulence of the wind sampled on a regular grid: the value noise is only evaluated at the resolution^3 samples,
+// then every triangle interpolates them trilinearly, so a coarser grid is both cheaper to bake and smoother
+struct WindField {
+	glm::vec3 origin = glm::vec3(0.f);
+	float cellSize = 1.f;
+	int resolution = 0; // samples per side, at least 2
+	std::vector<float> x; // sample (i, j, k) is at (k * resolution + j) * resolution + i
+	std::vector<float> y;
+	std::vector<float> z;
+};
+
+// Sizes the grid to a cube covering [boundsMin, boundsMax] with resolution samples per side
+void resizeWindField(WindField& field, const glm::vec3& boundsMin, const glm::vec3& boundsMax, int resolution);
+
+// Evaluates the slices [sliceBegin, sliceEnd) along z of a 3 channel value noise in [-1, 1], at sample * frequency + offset
+void bakeWindFieldSlices(WindField& field, float frequency, const glm::vec3& offset, size_t sliceBegin, size_t sliceEnd);
+
+struct AerodynamicParameters {
+	glm::vec3 wind = glm::vec3(0.f); // mean velocity of the air
+	float turbulence = 0.f; // scale of the field samples added to wind
+	float drag = 0.f; // force per unit of area and of relative velocity along the normal
+	float inverseStepSize = 1.f; // the velocities are (positions - oldPositions) * inverseStepSize
+};
+
+// Force on each triangle of [begin, end): drag * area * dot(n, air - velocity) * n, where n is the unit normal, velocity the mean
+// velocity of the vertices and air is wind + turbulence * field at the centroid. AVX2 handles 8 triangles at a time with gathers,
+// SSE2 4 with scalar loads. The forces are written at forceX[t], forceY[t], forceZ[t]. level must not be above detectSimdLevel().
+void computeAerodynamicForces(eSimdLevel level, const WindField& field, const AerodynamicParameters& parameters, const glm::vec3* positions,
+	const glm::vec3* oldPositions, const glm::ivec3* triangles, size_t begin, size_t end, float* forceX, float* forceY, float* forceZ);
@@ -1,5 +1,8 @@
 #include "drawbuffer.h"
 #include <glad.h>
+#include <string.h>
+
+#include <chrono>
 
 void createBuffer3D(Buffer3D& buffer, const CreateBuffer3DParams& params) {
 	assert(buffer.vao == 0); // trying to create a buffer already initialized
@@ -74,6 +77,36 @@ void deleteBuffer3D(Buffer3D& buffer) {
 	buffer.vao = 0;
 }
 
+void createIndexBuffer3D(IndexBuffer3D& buffer, unsigned int const* pIndices, GLsizei indexCount) {
+	assert(buffer.ibo == 0); // trying to create a buffer already initialized
+
+	glCreateBuffers(1, &buffer.ibo);
+	glNamedBufferStorage(buffer.ibo, (indexCount > 0 ? indexCount : 1) * sizeof(unsigned int), pIndices, GL_DYNAMIC_STORAGE_BIT); // empty storage is not allowed
+	buffer.indexCount = indexCount;
+}
+
+void deleteIndexBuffer3D(IndexBuffer3D& buffer) {
+	glDeleteBuffers(1, &buffer.ibo);
+	buffer.ibo = 0;
+	buffer.indexCount = 0;
+}
+
+void updateIndexBuffer3D(IndexBuffer3D& buffer, GLsizei firstIndex, unsigned int const* pIndices, GLsizei indexCount) {
+	assert(buffer.ibo); // did you call createIndexBuffer3D ?
+	glNamedBufferSubData(buffer.ibo, firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), pIndices);
+}
+
+void addInstanceAttribs3D(const Buffer3D& mesh) {
+	assert(mesh.vao); // did you call createBuffer3D ?
+
+	for (GLuint location = InstanceAttribCenterRadius; location < InstanceAttribEnd; ++location) {
+		glEnableVertexArrayAttrib(mesh.vao, location);
+		glVertexArrayAttribFormat(mesh.vao, location, 4, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(mesh.vao, location, location);
+		glVertexArrayBindingDivisor(mesh.vao, location, 1);
+	}
+}
+
 void createBuffer2D(Buffer2D& buffer, const CreateBuffer2DParams& params) {
 	glGenVertexArrays(1, &buffer.vao);
 	glGenBuffers(buffer.BufferAttribCount, buffer.vbos);
@@ -114,3 +147,107 @@ void deleteBuffer2D(Buffer2D& buffer) {
 	memset(buffer.vbos, 0, sizeof(buffer.vbos));
 	buffer.vao = 0;
 }
+
+bool createStreamBuffer(StreamBuffer& stream, GLsizeiptr regionSize) {
+	assert(stream.buffer == 0); // trying to create a buffer already initialized
+
+	stream.regionSize = (regionSize + StreamBuffer::Alignment - 1) / StreamBuffer::Alignment * StreamBuffer::Alignment;
+	const GLsizeiptr size = stream.regionSize * StreamBuffer::FrameCount;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &stream.buffer);
+	glNamedBufferStorage(stream.buffer, size, nullptr, flags);
+	stream.pMapped = (char*)glMapNamedBufferRange(stream.buffer, 0, size, flags);
+	if (!stream.pMapped) {
+		glDeleteBuffers(1, &stream.buffer);
+		stream.buffer = 0;
+		return false;
+	}
+
+	glCreateBuffers(1, &stream.overflowBuffer);
+
+	stream.region = 0;
+	stream.regionUsed = 0;
+	return true;
+}
+
+void deleteStreamBuffer(StreamBuffer& stream) {
+	for (GLsync& fence : stream.fences) {
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (stream.buffer) {
+		glUnmapNamedBuffer(stream.buffer);
+	}
+	glDeleteBuffers(1, &stream.buffer);
+	glDeleteBuffers(1, &stream.overflowBuffer);
+	stream.buffer = 0;
+	stream.overflowBuffer = 0;
+	stream.pMapped = nullptr;
+}
+
+void beginStreamBufferFrame(StreamBuffer& stream) {
+	stream.frameStats = StreamBuffer::Stats();
+	stream.regionUsed = 0;
+
+	GLsync& fence = stream.fences[stream.region];
+	if (!fence) {
+		return;
+	}
+
+	const auto waitStart = std::chrono::steady_clock::now();
+	GLbitfield waitFlags = 0;
+	for (;;) {
+		const GLenum result = glClientWaitSync(fence, waitFlags, 1000000 /*1ms*/);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+			break;
+		}
+		// make sure the fence gets submitted before waiting again
+		waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	}
+	const auto waitEnd = std::chrono::steady_clock::now();
+	stream.frameStats.fenceWaitMs = std::chrono::duration<float, std::milli>(waitEnd - waitStart).count();
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void endStreamBufferFrame(StreamBuffer& stream) {
+	assert(stream.fences[stream.region] == nullptr);
+	stream.fences[stream.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stream.region = (stream.region + 1) % StreamBuffer::FrameCount;
+	stream.lastFrameStats = stream.frameStats;
+}
+
+StreamAllocation allocateStreamBuffer(StreamBuffer& stream, GLsizeiptr size) {
+	assert(stream.buffer); // did you call createStreamBuffer ?
+
+	size = (size + StreamBuffer::Alignment - 1) / StreamBuffer::Alignment * StreamBuffer::Alignment;
+	stream.frameStats.usedBytes += size;
+	stream.frameStats.allocationCount++;
+
+	StreamAllocation allocation;
+	allocation.size = size;
+	if (stream.regionUsed + size <= stream.regionSize) {
+		allocation.buffer = stream.buffer;
+		allocation.offset = stream.region * stream.regionSize + stream.regionUsed;
+		allocation.pData = stream.pMapped + allocation.offset;
+		stream.regionUsed += size;
+	}
+	else {
+		stream.frameStats.overflowBytes += size;
+		stream.overflowData.resize(size);
+		allocation.buffer = stream.overflowBuffer;
+		allocation.offset = 0;
+		allocation.pData = stream.overflowData.data();
+	}
+	return allocation;
+}
+
+void commitStreamAllocation(StreamBuffer& stream, const StreamAllocation& allocation) {
+	// the mapping is coherent, only the overflow data still has to be uploaded
+	if (allocation.buffer == stream.overflowBuffer) {
+		// orphan the previous storage, the driver does not have to wait for the draws still using it
+		glNamedBufferData(stream.overflowBuffer, allocation.size, allocation.pData, GL_STREAM_DRAW);
+	}
+}
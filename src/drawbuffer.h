@@ -5,6 +5,8 @@
 #include <glm/vec4.hpp>
 #include <glad.h>
 
+#include <vector>
+
 struct Buffer3D {
 	enum {
 		BufferAttribVertex = 0,
@@ -32,6 +34,33 @@ void createBuffer3D(Buffer3D& buffer, const CreateBuffer3DParams& params);
 
 void deleteBuffer3D(Buffer3D& buffer);
 
+// Indices kept on the gpu for a mesh whose topology is fixed but whose vertices are streamed every frame,
+// see RenderApi3D::streamedMesh
+struct IndexBuffer3D {
+	GLuint ibo = 0;
+	GLsizei indexCount = 0;
+};
+
+void createIndexBuffer3D(IndexBuffer3D& buffer, unsigned int const* pIndices, GLsizei indexCount);
+
+void deleteIndexBuffer3D(IndexBuffer3D& buffer);
+
+// Overwrites indexCount indices from firstIndex, buffer.indexCount is left to the caller
+void updateIndexBuffer3D(IndexBuffer3D& buffer, GLsizei firstIndex, unsigned int const* pIndices, GLsizei indexCount);
+
+// Per instance attributes read by shader_3d_instanced.vert, right after the Buffer3D ones.
+// Their data is not owned by the mesh, bind it before each draw with glVertexArrayVertexBuffer
+// on the binding index of the same value.
+enum {
+	InstanceAttribCenterRadius = Buffer3D::BufferAttribCount,
+	InstanceAttribColor,
+	InstanceAttribEnd
+};
+
+// Declares the per instance attributes on the vao of a Buffer3D, so that the mesh can be drawn
+// many times in one instanced draw call.
+void addInstanceAttribs3D(const Buffer3D& mesh);
+
 struct Buffer2D {
 	enum {
 		BufferAttribVertex = 0,
@@ -52,3 +81,54 @@ struct CreateBuffer2DParams {
 void createBuffer2D(Buffer2D& buffer, const CreateBuffer2DParams& params);
 
 void deleteBuffer2D(Buffer2D& buffer);
+
+// Persistently mapped buffer for the geometry rebuilt every frame. It is split in FrameCount
+// regions used in turn and a fence is inserted after the draws of each frame, so the cpu only
+// waits when it laps the gpu. Allocations that do not fit the region of the frame fall back to
+// an orphaned buffer, grow regionSize if overflowBytes is not 0.
+struct StreamBuffer {
+	static constexpr int FrameCount = 3;
+	static constexpr GLsizeiptr Alignment = 256;
+
+	struct Stats {
+		float fenceWaitMs = 0.f;
+		GLsizeiptr usedBytes = 0;
+		GLsizeiptr overflowBytes = 0;
+		int allocationCount = 0;
+	};
+
+	GLuint buffer = 0;
+	char* pMapped = nullptr;
+	GLsizeiptr regionSize = 0;
+	int region = 0;
+	GLsizeiptr regionUsed = 0;
+	GLsync fences[FrameCount] = {};
+
+	GLuint overflowBuffer = 0;
+	std::vector<char> overflowData;
+
+	Stats frameStats; // frame being recorded
+	Stats lastFrameStats; // last finished frame
+};
+
+struct StreamAllocation {
+	char* pData = nullptr; // write the data here, then call commitStreamAllocation before drawing
+	GLuint buffer = 0;
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+bool createStreamBuffer(StreamBuffer& stream, GLsizeiptr regionSize);
+
+void deleteStreamBuffer(StreamBuffer& stream);
+
+// Waits until the gpu is done with the region of the new frame
+void beginStreamBufferFrame(StreamBuffer& stream);
+
+void endStreamBufferFrame(StreamBuffer& stream);
+
+// Reserves size bytes, the offset of the allocation is a multiple of Alignment.
+// Commit an allocation before reserving the next one, overflow allocations share their storage.
+StreamAllocation allocateStreamBuffer(StreamBuffer& stream, GLsizeiptr size);
+
+void commitStreamAllocation(StreamBuffer& stream, const StreamAllocation& allocation);
@@ -1,6 +1,8 @@
 #include "../viewer.h"
 #include "../drawbuffer.h"
 #include "../renderapi.h"
+#include "../boids/colliders.h"
+#include "../boids/meshcollider.h"
 
 #include <time.h>
 #include <iostream>
@@ -12,6 +14,7 @@
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <vector>
+#include <chrono>
 
 #define COUNTOF(ARRAY) (sizeof(ARRAY) / sizeof(ARRAY[0]))
 
@@ -72,6 +75,24 @@ struct ParticlesViewer : Viewer {
 	int ParticleVeloRandom = 5.f;
 	int VoidStrgRandom = 5.f;
 
+	// Colliders, the particles bounce on them after every update
+	bool collisions = true;
+	ColliderSet colliders;
+	float restitution = 0.5f; // share of the normal velocity kept by a bounce
+	eSimdLevel simdLevel = eSimdLevel::Scalar; // at most detectSimdLevel()
+
+	// Wavy triangle mesh above the floor, its hierarchy is refit while it animates
+	bool meshCollisions = true;
+	MeshCollider meshCollider;
+	int meshResolution = 32; // quads per side, 2 triangles each
+	bool animateMesh = false;
+	float meshTime = 0.f;
+	std::vector<glm::vec3> meshNormals;
+	IndexBuffer3D meshIndices;
+	size_t meshIndicesTriangleCount = 0; // of meshIndices
+	size_t meshQueryCount = 0; // during the last update
+	float meshQueryDurationMs = 0.f;
+
 	//Inputs
 	glm::vec2 mousePos;
 
@@ -99,6 +120,80 @@ struct ParticlesViewer : Viewer {
 		voidPoints = {
 			VoidPoint(0,0,0,1),
 		};
+
+		simdLevel = detectSimdLevel();
+		colliders.spheres.push_back({ glm::vec3(1.5f, 0.f, 0.f), 0.6f });
+		colliders.capsules.push_back({ glm::vec3(-2.f, -1.f, 0.f), glm::vec3(-1.f, 1.f, 0.f), 0.3f });
+		colliders.planes.push_back({ glm::vec3(0.f, 1.f, 0.f), -3.f });
+		const glm::vec3 torusCenter = glm::vec3(0.f, -1.5f, 0.f);
+		colliders.sdfGrids.emplace_back();
+		bakeSdfGridCollider(colliders.sdfGrids.back(), torusCenter - glm::vec3(1.5f), 0.1f, glm::ivec3(31), [&](const glm::vec3& position) {
+			const glm::vec3 local = position - torusCenter;
+			const glm::vec2 toTube = glm::vec2(glm::length(glm::vec2(local.x, local.z)) - 1.f, local.y);
+			return glm::length(toTube) - 0.3f;
+		});
+
+		makeWavyMeshCollider(meshCollider, glm::vec3(0.f, -2.5f, 0.f), 6.f, meshResolution, 0.3f, meshTime);
+		buildMeshCollider(meshCollider);
+		computeMeshColliderNormals(meshCollider, meshNormals);
+	}
+
+	// The simulated particles are pushed out of the colliders by batches, the ones that moved lose their velocity
+	// toward the collider, scaled by restitution
+	void collideParticles() {
+		float x[ColliderBatchSize];
+		float y[ColliderBatchSize];
+		float z[ColliderBatchSize];
+		Particle* batch[ColliderBatchSize];
+		std::chrono::steady_clock::duration meshQueryDuration{};
+		meshQueryCount = 0;
+		for (size_t p = 0; p < particles.size(); ) {
+			size_t count = 0;
+			for (; p < particles.size() && count < ColliderBatchSize; p++) {
+				if (!particles[p]->isSimulated) {
+					continue;
+				}
+				batch[count] = particles[p];
+				x[count] = particles[p]->Position.x;
+				y[count] = particles[p]->Position.y;
+				z[count] = particles[p]->Position.z;
+				count++;
+			}
+
+			if (collisions) {
+				collideParticleBatch(simdLevel, colliders, particleSize, x, y, z, count);
+			}
+			if (meshCollisions) {
+				const auto start = std::chrono::steady_clock::now();
+				collideMeshColliderBatch(meshCollider, particleSize, x, y, z, count);
+				meshQueryDuration += std::chrono::steady_clock::now() - start;
+				meshQueryCount += count;
+			}
+			for (size_t i = 0; i < count; i++) {
+				Particle* particle = batch[i];
+				const glm::vec3 push = glm::vec3(x[i], y[i], z[i]) - particle->Position;
+				const float pushLength = glm::length(push);
+				if (pushLength > 0.f) {
+					const glm::vec3 normal = push / pushLength;
+					particle->Position += push;
+					particle->Velocity -= (1.f + restitution) * glm::min(glm::dot(particle->Velocity, normal), 0.f) * normal;
+				}
+			}
+		}
+		meshQueryDurationMs = std::chrono::duration<float, std::milli>(meshQueryDuration).count();
+	}
+
+	// Built after a resolution change, otherwise the triangles stay the same and the hierarchy only has its bounds refit
+	void animateMeshCollider(float time) {
+		meshTime = time;
+		makeWavyMeshCollider(meshCollider, glm::vec3(0.f, -2.5f, 0.f), 6.f, meshResolution, 0.3f, meshTime);
+		if (meshCollider.nodes.empty()) {
+			buildMeshCollider(meshCollider);
+		}
+		else {
+			refitMeshCollider(meshCollider);
+		}
+		computeMeshColliderNormals(meshCollider, meshNormals);
 	}
 
 	void update(double elapsedTime) override {
@@ -121,6 +216,14 @@ struct ParticlesViewer : Viewer {
 
 		//create particle from mouse pos
 
+		if (meshCollisions && animateMesh) {
+			animateMeshCollider(float(elapsedTime));
+		}
+		if (meshIndicesTriangleCount != meshCollider.triangles.size()) {
+			deleteIndexBuffer3D(meshIndices);
+			createIndexBuffer3D(meshIndices, (unsigned int const*)meshCollider.triangles.data(), GLsizei(3 * meshCollider.triangles.size()));
+			meshIndicesTriangleCount = meshCollider.triangles.size();
+		}
 
 		for (Particle* particle: particles) {
 			particle->Update();
@@ -128,6 +231,9 @@ struct ParticlesViewer : Viewer {
 				particle->AttractTo(element);
 			}
 		}
+		if (collisions || meshCollisions) {
+			collideParticles();
+		}
 	}
 
 	void render3D_custom(const RenderApi3D& api) const override {
@@ -142,13 +248,27 @@ struct ParticlesViewer : Viewer {
 
 		api.axisXYZ(nullptr);
 
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec4> colors;
+		positions.reserve(particles.size() + voidPoints.size());
+		colors.reserve(particles.size() + voidPoints.size());
 		for (Particle* particle: particles) {
-			api.solidSphere(particle->Position, particleSize, 100, 100, particlesRed);
+			positions.push_back(particle->Position);
+			colors.push_back(particlesRed);
 		}
 		for (VoidPoint voidPoint: voidPoints) {
-			api.solidSphere(voidPoint.Position, particleSize, 100, 100, particlesWhite);
+			positions.push_back(voidPoint.Position);
+			colors.push_back(particlesWhite);
 		}
+		std::vector<float> radii(positions.size(), particleSize);
+		api.instancedSpheres(positions.data(), radii.data(), colors.data(), (unsigned int)positions.size());
 
+		if (collisions) {
+			drawColliders(api, colliders, glm::vec4(0.6f, 0.6f, 0.6f, 1.f));
+		}
+		if (meshCollisions && meshIndices.ibo && meshNormals.size() == meshCollider.vertices.size()) {
+			api.streamedMesh(meshCollider.vertices.data(), meshNormals.data(), (unsigned int)meshCollider.vertices.size(), meshIndices, eDrawMode::Triangles, glm::vec4(0.6f, 0.5f, 0.4f, 1.f));
+		}
 	}
 
 	void render2D(const RenderApi2D& api) const override {
@@ -224,6 +344,29 @@ struct ParticlesViewer : Viewer {
 		ImGui::SliderInt("Start Velocity", &ParticleVeloRandom, 0.f, 50.f);
 		ImGui::SliderInt("Void Point Random", &VoidStrgRandom, 0.f, 10.f);
 
+		ImGui::Checkbox("Colliders", &collisions);
+		if (collisions) {
+			ImGui::SliderFloat("Restitution", &restitution, 0.f, 1.f);
+			for (int level = 0; level <= (int)detectSimdLevel(); level++) {
+				if (level > 0) {
+					ImGui::SameLine();
+				}
+				ImGui::RadioButton(simdLevelName((eSimdLevel)level), (int*)&simdLevel, level);
+			}
+		}
+		ImGui::Checkbox("Mesh collider", &meshCollisions);
+		if (meshCollisions) {
+			// the hierarchy is rebuilt once the slider is released, it takes about a second for a million triangles
+			ImGui::SliderInt("Mesh resolution (quads)", &meshResolution, 2, 708);
+			if (ImGui::IsItemDeactivatedAfterEdit()) {
+				meshCollider.nodes.clear();
+				animateMeshCollider(meshTime);
+			}
+			ImGui::Checkbox("Animate mesh", &animateMesh);
+			const double queriesPerSecond = meshQueryDurationMs > 0.f ? 1000.0 * meshQueryCount / meshQueryDurationMs : 0.0;
+			ImGui::Text("%d triangles, %d queries in %.3f ms, %.2f M queries/s", int(meshCollider.triangles.size()), int(meshQueryCount), meshQueryDurationMs, 1e-6 * queriesPerSecond);
+		}
+
 		if (ImGui::CollapsingHeader("3D Sandbox param")) {
 			ImGui::Checkbox("Show demo window", &showDemoWindow);
 
@@ -253,6 +396,7 @@ struct ParticlesViewer : Viewer {
 		//ImGui::SliderFloat3("Cube Position", (float(&)[3])cubePosition, -1.f, 1.f);
 
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		drawRenderStatsGUI();
 		ImGui::Text("Mouse position x: %.0f y: %.0f", mousePos.x, mousePos.y);
 
 		ImGui::End();
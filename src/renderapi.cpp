@@ -5,6 +5,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/common.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <string.h>
 
 #define COUNTOF(ARRAY) (sizeof(ARRAY) / sizeof(ARRAY[0]))
 
@@ -53,26 +57,200 @@ void RenderApi3D::buffer(const Buffer3D& buffer, eDrawMode drawMode, glm::mat4 c
 	glBindVertexArray(0);
 }
 
-void RenderApi3D::lines(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel) const {
-	glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
+namespace {
+	// sub arrays of one stream allocation start on a 16 bytes boundary
+	GLsizeiptr alignStreamOffset(GLsizeiptr offset) {
+		return (offset + 15) & ~GLsizeiptr(15);
 	}
 
-	Buffer3D buffer3D;
+	// One draw worth of 3d geometry, written by the caller straight into the streaming buffer
+	struct StreamedGeometry3D {
+		StreamAllocation allocation;
+		glm::vec3* pVertices = nullptr;
+		glm::vec3* pNormals = nullptr; // null if the geometry is not lit
+		glm::vec4* pColors = nullptr; // null if the geometry uses the uniform color
+		GLintptr normalsOffset = 0;
+		GLintptr colorsOffset = 0;
+		GLsizei vertexCount = 0;
+	};
+
+	StreamedGeometry3D allocateStreamedGeometry3D(RenderEngine& engine, GLsizei vertexCount, bool withNormals, bool withColors) {
+		StreamedGeometry3D geometry;
+		geometry.vertexCount = vertexCount;
+
+		GLsizeiptr size = vertexCount * sizeof(glm::vec3);
+		if (withNormals) {
+			geometry.normalsOffset = alignStreamOffset(size);
+			size = geometry.normalsOffset + vertexCount * sizeof(glm::vec3);
+		}
+		if (withColors) {
+			geometry.colorsOffset = alignStreamOffset(size);
+			size = geometry.colorsOffset + vertexCount * sizeof(glm::vec4);
+		}
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = nullptr;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+		geometry.allocation = allocateStreamBuffer(engine.streamBuffer, size);
+		char* pData = geometry.allocation.pData;
+		geometry.pVertices = (glm::vec3*)pData;
+		geometry.pNormals = withNormals ? (glm::vec3*)(pData + geometry.normalsOffset) : nullptr;
+		geometry.pColors = withColors ? (glm::vec4*)(pData + geometry.colorsOffset) : nullptr;
+		return geometry;
+	}
 
-	buffer(buffer3D, eDrawMode::Lines, pModel);
+	// Geometry without colors is drawn with the color uniform of the shader, geometry with pIndexBuffer is indexed by it
+	void drawStreamedGeometry3D(const RenderApi3D& api, const StreamedGeometry3D& geometry, eDrawMode drawMode, glm::mat4 const* pModel, IndexBuffer3D const* pIndexBuffer = nullptr) {
+		RenderEngine& engine = *api.pRenderEngine;
+		const ShaderProgram3D& shader = *api.pShader3D;
+		commitStreamAllocation(engine.streamBuffer, geometry.allocation);
+
+		glm::mat4 model = pModel ? *pModel : glm::identity<glm::mat4>();
+		glProgramUniformMatrix4fv(shader.programId, shader.modelLocation, 1, 0, glm::value_ptr(model));
+
+		const bool lightingEnabled = geometry.pNormals != nullptr;
+		glProgramUniform1i(shader.programId, shader.lightingEnabledLocation, lightingEnabled);
+
+		const GLuint vao = engine.streamVao3D;
+		const GLuint streamBuffer = geometry.allocation.buffer;
+		const GLintptr offset = geometry.allocation.offset;
+		glVertexArrayVertexBuffer(vao, Buffer3D::BufferAttribVertex, streamBuffer, offset, sizeof(glm::vec3));
+		if (lightingEnabled) {
+			glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribNormal);
+			glVertexArrayVertexBuffer(vao, Buffer3D::BufferAttribNormal, streamBuffer, offset + geometry.normalsOffset, sizeof(glm::vec3));
+		}
+		else {
+			glDisableVertexArrayAttrib(vao, Buffer3D::BufferAttribNormal);
+		}
+		if (geometry.pColors) {
+			glEnableVertexArrayAttrib(vao, Buffer3D::BufferAttribColor);
+			glVertexArrayVertexBuffer(vao, Buffer3D::BufferAttribColor, streamBuffer, offset + geometry.colorsOffset, sizeof(glm::vec4));
+		}
+		else {
+			glDisableVertexArrayAttrib(vao, Buffer3D::BufferAttribColor);
+		}
 
-	deleteBuffer3D(buffer3D);
+		glBindVertexArray(vao);
+		if (pIndexBuffer) {
+			glVertexArrayElementBuffer(vao, pIndexBuffer->ibo);
+			glDrawElements((GLenum)drawMode, pIndexBuffer->indexCount, GL_UNSIGNED_INT, nullptr);
+		}
+		else {
+			glDrawArrays((GLenum)drawMode, 0, geometry.vertexCount);
+		}
+		glBindVertexArray(0);
+	}
 
-	Allocator.Free(colors);
+	// Returns the cached mesh of key, createMesh(Buffer3D&) is only called when it is missing
+	template <typename CreateMesh>
+	const Buffer3D& cachedMesh(MeshCache& cache, const MeshCache::Key& key, CreateMesh createMesh) {
+		for (MeshCache::Entry& entry : cache.entries) {
+			if (entry.key.primitive == key.primitive && entry.key.subdivisions[0] == key.subdivisions[0] && entry.key.subdivisions[1] == key.subdivisions[1]) {
+				entry.lastUsedFrame = cache.frame;
+				return entry.buffer;
+			}
+		}
+
+		MeshCache::Entry entry;
+		entry.key = key;
+		entry.lastUsedFrame = cache.frame;
+		createMesh(entry.buffer);
+		cache.entries.push_back(entry);
+		return cache.entries.back().buffer;
+	}
+
+	void drawCachedMesh(const RenderApi3D& api, const Buffer3D& mesh, const glm::vec4& color, const glm::mat4& model) {
+		const ShaderProgram3D& shader = *api.pShader3D;
+		glProgramUniform1i(shader.programId, shader.useUniformColorLocation, 1);
+		glProgramUniform4fv(shader.programId, shader.uniformColorLocation, 1, glm::value_ptr(color));
+		api.buffer(mesh, eDrawMode::Triangles, &model);
+		glProgramUniform1i(shader.programId, shader.useUniformColorLocation, 0);
+	}
+
+	// Appends count vertices transformed by pModel to stream, returns the index of the first one.
+	// The colors of the new vertices are left to the caller.
+	size_t appendImmediateVertices(ImmediateBatch3D::Stream& stream, glm::vec3 const* vertices, glm::vec3 const* normals, unsigned int count, glm::mat4 const* pModel) {
+		const size_t first = stream.vertices.size();
+		stream.vertices.resize(first + count);
+		stream.colors.resize(first + count);
+		if (normals) {
+			stream.normals.resize(first + count);
+		}
+
+		if (pModel) {
+			const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(*pModel)));
+			for (unsigned int i = 0; i < count; ++i) {
+				stream.vertices[first + i] = glm::vec3(*pModel * glm::vec4(vertices[i], 1.f));
+				if (normals) {
+					stream.normals[first + i] = glm::normalize(normalMatrix * normals[i]);
+				}
+			}
+		}
+		else {
+			memcpy(&stream.vertices[first], vertices, count * sizeof(glm::vec3));
+			if (normals) {
+				memcpy(&stream.normals[first], normals, count * sizeof(glm::vec3));
+			}
+		}
+		return first;
+	}
+
+	void appendImmediate(ImmediateBatch3D::Stream& stream, glm::vec3 const* vertices, glm::vec3 const* normals, unsigned int count, const glm::vec4& color, glm::mat4 const* pModel) {
+		const size_t first = appendImmediateVertices(stream, vertices, normals, count, pModel);
+		std::fill(stream.colors.begin() + first, stream.colors.end(), color);
+	}
+}
+
+void RenderApi3D::flush() const {
+	ImmediateBatch3D& batch = pRenderEngine->immediateBatch3D;
+
+	const eDrawMode streamDrawModes[ImmediateBatch3D::StreamCount] = {
+		eDrawMode::Lines,
+		eDrawMode::Triangles,
+	};
+
+	for (int iStream = 0; iStream < ImmediateBatch3D::StreamCount; ++iStream) {
+		ImmediateBatch3D::Stream& stream = batch.streams[iStream];
+		if (stream.vertices.empty()) {
+			continue;
+		}
+
+		const GLsizei vertexCount = GLsizei(stream.vertices.size());
+		const bool withNormals = !stream.normals.empty();
+		StreamedGeometry3D geometry = allocateStreamedGeometry3D(*pRenderEngine, vertexCount, withNormals, true);
+		memcpy(geometry.pVertices, stream.vertices.data(), vertexCount * sizeof(glm::vec3));
+		if (withNormals) {
+			memcpy(geometry.pNormals, stream.normals.data(), vertexCount * sizeof(glm::vec3));
+		}
+		memcpy(geometry.pColors, stream.colors.data(), vertexCount * sizeof(glm::vec4));
+
+		drawStreamedGeometry3D(*this, geometry, streamDrawModes[iStream], nullptr);
+
+		// keep the capacity for the next frame
+		stream.vertices.clear();
+		stream.normals.clear();
+		stream.colors.clear();
+	}
+}
+
+void RenderApi3D::lines(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel) const {
+	ImmediateBatch3D::Stream& stream = pRenderEngine->immediateBatch3D.streams[ImmediateBatch3D::StreamLines];
+	appendImmediate(stream, vertices, nullptr, vertexCount, color, pModel);
+}
+
+void RenderApi3D::streamedMesh(glm::vec3 const* positions, glm::vec3 const* normals, unsigned int vertexCount, const IndexBuffer3D& indexBuffer, eDrawMode drawMode, const glm::vec4& color) const {
+	assert(indexBuffer.ibo); // did you call createIndexBuffer3D ?
+	if (vertexCount == 0 || indexBuffer.indexCount == 0) {
+		return;
+	}
+
+	StreamedGeometry3D geometry = allocateStreamedGeometry3D(*pRenderEngine, vertexCount, normals != nullptr, false);
+	memcpy(geometry.pVertices, positions, vertexCount * sizeof(glm::vec3));
+	if (normals) {
+		memcpy(geometry.pNormals, normals, vertexCount * sizeof(glm::vec3));
+	}
+
+	glProgramUniform1i(pShader3D->programId, pShader3D->useUniformColorLocation, 1);
+	glProgramUniform4fv(pShader3D->programId, pShader3D->uniformColorLocation, 1, glm::value_ptr(color));
+	drawStreamedGeometry3D(*this, geometry, drawMode, nullptr, &indexBuffer);
+	glProgramUniform1i(pShader3D->programId, pShader3D->useUniformColorLocation, 0);
 }
 
 void RenderApi3D::grid(float size, unsigned int subdivisions, const glm::vec4& color, glm::mat4 const* pModel) const {
@@ -81,7 +259,6 @@ void RenderApi3D::grid(float size, unsigned int subdivisions, const glm::vec4& c
 	const unsigned int lineCount = 4 + 2 * (subdivisions - 1);
 	const unsigned int vertexCount = 2 * lineCount;
 	glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
 
 	const float halfSize = 0.5f * size;
 
@@ -104,24 +281,9 @@ void RenderApi3D::grid(float size, unsigned int subdivisions, const glm::vec4& c
 		vertices[iVertex++] = glm::vec3(halfSize, 0.f, coord);
 	}
 
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
-	}
-
-	Buffer3D buffer3D;
-
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = nullptr;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
-
-	buffer(buffer3D, eDrawMode::Lines, pModel);
+	ImmediateBatch3D::Stream& stream = pRenderEngine->immediateBatch3D.streams[ImmediateBatch3D::StreamLines];
+	appendImmediate(stream, vertices, nullptr, vertexCount, color, pModel);
 
-	deleteBuffer3D(buffer3D);
-
-	Allocator.Free(colors);
 	Allocator.Free(vertices);
 }
 
@@ -146,184 +308,227 @@ void RenderApi3D::axisXYZ(glm::mat4 const* pModel) const {
 		glm::vec4(0.f, 0.f, 1.f, 1.f),
 	};
 
-	Buffer3D buffer3D;
-
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = nullptr;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
-
-	buffer(buffer3D, eDrawMode::Lines, pModel);
-
-	deleteBuffer3D(buffer3D);
+	ImmediateBatch3D::Stream& stream = pRenderEngine->immediateBatch3D.streams[ImmediateBatch3D::StreamLines];
+	const size_t first = appendImmediateVertices(stream, vertices, nullptr, vertexCount, pModel);
+	std::copy(colors, colors + vertexCount, stream.colors.begin() + first);
 }
 
 void RenderApi3D::solidCube(float size, const glm::vec4& color, glm::mat4 const* pModel) const {
-	const float halfsize = size * 0.5f;
-	glm::vec3 edges[8] =
-	{
-		{ -halfsize, -halfsize, -halfsize},
-		{ +halfsize, -halfsize, -halfsize},
-		{ +halfsize, +halfsize, -halfsize},
-		{ -halfsize, +halfsize, -halfsize},
-		{ -halfsize, -halfsize, +halfsize},
-		{ +halfsize, -halfsize, +halfsize},
-		{ +halfsize, +halfsize, +halfsize},
-		{ -halfsize, +halfsize, +halfsize},
-	};
+	const MeshCache::Key key = { MeshCache::ePrimitive::Cube, { 0, 0 } };
+	const Buffer3D& mesh = cachedMesh(pRenderEngine->meshCache, key, [](Buffer3D& buffer) {
+		const float halfsize = 0.5f;
+		glm::vec3 edges[8] =
+		{
+			{ -halfsize, -halfsize, -halfsize},
+			{ +halfsize, -halfsize, -halfsize},
+			{ +halfsize, +halfsize, -halfsize},
+			{ -halfsize, +halfsize, -halfsize},
+			{ -halfsize, -halfsize, +halfsize},
+			{ +halfsize, -halfsize, +halfsize},
+			{ +halfsize, +halfsize, +halfsize},
+			{ -halfsize, +halfsize, +halfsize},
+		};
 
-	glm::vec3 faceNormals[6] =
-	{
-		{ 0, 0, -1 },
-		{ +1, 0, 0 },
-		{ 0, 0, +1 },
-		{ -1, 0, 0 },
-		{ 0, +1, 0 },
-		{ 0, -1, 0 },
-	};
+		glm::vec3 faceNormals[6] =
+		{
+			{ 0, 0, -1 },
+			{ +1, 0, 0 },
+			{ 0, 0, +1 },
+			{ -1, 0, 0 },
+			{ 0, +1, 0 },
+			{ 0, -1, 0 },
+		};
 
-	int indices[36] =
-	{
-		0, 1, 3, 3, 1, 2,
-		1, 5, 2, 2, 5, 6,
-		5, 4, 6, 6, 4, 7,
-		4, 0, 7, 7, 0, 3,
-		3, 2, 7, 7, 2, 6,
-		4, 5, 0, 0, 5, 1
-	};
+		int indices[36] =
+		{
+			0, 1, 3, 3, 1, 2,
+			1, 5, 2, 2, 5, 6,
+			5, 4, 6, 6, 4, 7,
+			4, 0, 7, 7, 0, 3,
+			3, 2, 7, 7, 2, 6,
+			4, 5, 0, 0, 5, 1
+		};
 
-	constexpr size_t vertexCount = 36;
-	float vertices[3 * vertexCount];
-	for (int i = 0; i < 36; i++) {
-		vertices[i * 3 + 0] = edges[indices[i]].x;
-		vertices[i * 3 + 1] = edges[indices[i]].y;
-		vertices[i * 3 + 2] = edges[indices[i]].z;
-	}
+		constexpr size_t vertexCount = 36;
+		glm::vec3 vertices[vertexCount];
+		glm::vec3 normals[vertexCount];
+		glm::vec4 colors[vertexCount];
+		for (int i = 0; i < 36; i++) {
+			vertices[i] = edges[indices[i]];
+			normals[i] = faceNormals[i / 6];
+			colors[i] = glm::vec4(1.f);
+		}
 
-	float normals[3 * vertexCount];
-	for (int i = 0; i < 36; i++) {
-		normals[i * 3 + 0] = faceNormals[i / 6].x;
-		normals[i * 3 + 1] = faceNormals[i / 6].y;
-		normals[i * 3 + 2] = faceNormals[i / 6].z;
+		CreateBuffer3DParams createCubeBufferParams;
+		createCubeBufferParams.pVertices = vertices;
+		createCubeBufferParams.pNormals = normals;
+		createCubeBufferParams.pColors = colors;
+		createCubeBufferParams.vertexCount = vertexCount;
+		createBuffer3D(buffer, createCubeBufferParams);
+	});
+
+	const glm::mat4 model = pModel ? *pModel : glm::identity<glm::mat4>();
+	drawCachedMesh(*this, mesh, color, glm::scale(model, glm::vec3(size)));
+}
+
+namespace {
+	unsigned int sphereVertexCount(unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions) {
+		return 2 + horizontalSubdivisions * (verticalSubdivisions - 1);
 	}
 
-	glm::vec4 colors[vertexCount];
-	for (int iColor = 0; iColor < 6 * 6; ++iColor) {
-		colors[iColor] = color;
+	unsigned int sphereIndexCount(unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions) {
+		return (2 * horizontalSubdivisions + (verticalSubdivisions - 2) * horizontalSubdivisions * 2) * 3;
 	}
 
-	Buffer3D buffer3D;
+	// vertices, normals and colors must hold sphereVertexCount() elements, indices sphereIndexCount()
+	void tessellateSphere(const glm::vec3& center, float radius, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions, const glm::vec4& color,
+		glm::vec3* vertices, glm::vec3* normals, glm::vec4* colors, unsigned int* indices) {
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = reinterpret_cast<glm::vec3*>(vertices);
-	createCubeBufferParams.pNormals = reinterpret_cast<glm::vec3*>(normals);
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+		const int vertexCount = sphereVertexCount(horizontalSubdivisions, verticalSubdivisions);
 
-	buffer(buffer3D, eDrawMode::Triangles, pModel);
+		int iVertex = 0;
 
-	deleteBuffer3D(buffer3D);
-}
+		const float verticalStep = glm::pi<float>() / verticalSubdivisions;
+		const float horizontalStep = glm::two_pi<float>() / horizontalSubdivisions;
+		for (unsigned int i = 1; i < verticalSubdivisions; ++i) {
+			const float verticalAngle = glm::half_pi<float>() - i * verticalStep;
 
-void RenderApi3D::solidSphere(const glm::vec3& center, float radius, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions, const glm::vec4& color) const {
-	
-	horizontalSubdivisions = glm::max(horizontalSubdivisions, 4u);
-	verticalSubdivisions = glm::max(verticalSubdivisions, 2u);
+			const float xz = radius * glm::cos(verticalAngle);
+			const float y = radius * glm::sin(verticalAngle);
 
-	const int vertexCount = 2 + horizontalSubdivisions * (verticalSubdivisions - 1);
+			for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
+				const float horizontalAngle = j * horizontalStep;
+				const float x = xz * glm::cos(horizontalAngle);
+				const float z = xz * glm::sin(horizontalAngle);
 
-	glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec3* normals = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
 
-	int iVertex = 0;
+				vertices[iVertex] = center + glm::vec3(x, y, z);
+				normals[iVertex] = glm::vec3(x / radius, y / radius, z / radius);
+				colors[iVertex] = color;
+				iVertex++;
+			}
+		}
 
-	const float verticalStep = glm::pi<float>() / verticalSubdivisions;
-	const float horizontalStep = glm::two_pi<float>() / horizontalSubdivisions;
-	for (unsigned int i = 1; i < verticalSubdivisions; ++i) {
-		const float verticalAngle = glm::half_pi<float>() - i * verticalStep;
+		vertices[iVertex] = center + glm::vec3(0.f, radius, 0.f);
+		normals[iVertex] = glm::vec3(0.f, 1.f, 0.f);
+		colors[iVertex] = color;
+		iVertex++;
 
-		const float xz = radius * glm::cos(verticalAngle);
-		const float y = radius * glm::sin(verticalAngle);
+		vertices[iVertex] = center + glm::vec3(0.f, -radius, 0.f);
+		normals[iVertex] = glm::vec3(0.f, -1.f, 0.f);
+		colors[iVertex] = color;
+		iVertex++;
 
+		unsigned int iIndex = 0;
+		const int iFirstLine = 0;
 		for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-			const float horizontalAngle = j * horizontalStep;
-			const float x = xz * glm::cos(horizontalAngle);
-			const float z = xz * glm::sin(horizontalAngle);
+			indices[iIndex++] = vertexCount - 2;
+			indices[iIndex++] = iFirstLine + j;
+			indices[iIndex++] = iFirstLine + ((j + 1) % horizontalSubdivisions);
+		}
 
+		for (unsigned int i = 0; i < verticalSubdivisions - 2; ++i) {
+			for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
+				const unsigned int iA = (i * horizontalSubdivisions) + j;
+				const unsigned int iB = (i * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
+				const unsigned int iC = ((i + 1) * horizontalSubdivisions) + j;
+				const unsigned int iD = ((i + 1) * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
+				indices[iIndex++] = iA;
+				indices[iIndex++] = iC;
+				indices[iIndex++] = iD;
+				indices[iIndex++] = iA;
+				indices[iIndex++] = iD;
+				indices[iIndex++] = iB;
+			}
+		}
 
-			vertices[iVertex] = center + glm::vec3(x, y, z);
-			normals[iVertex] = glm::vec3(x / radius, y / radius, z / radius);
-			colors[iVertex] = color;
-			iVertex++;
+		const int iLastLine = (verticalSubdivisions - 2) * horizontalSubdivisions;
+		for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
+			indices[iIndex++] = vertexCount - 1;
+			indices[iIndex++] = iLastLine + j;
+			indices[iIndex++] = iLastLine + ((j + 1) % horizontalSubdivisions);
 		}
 	}
 
-	vertices[iVertex] = center + glm::vec3(0.f, radius, 0.f);
-	normals[iVertex] = glm::vec3(0.f, 1.f, 0.f);
-	colors[iVertex] = color;
-	iVertex++;
-
-	vertices[iVertex] = center + glm::vec3(0.f, -radius, 0.f);
-	normals[iVertex] = glm::vec3(0.f, -1.f, 0.f);
-	colors[iVertex] = color;
-	iVertex++;
-
-	const unsigned int indexCount = (2 * horizontalSubdivisions + (verticalSubdivisions - 2) * horizontalSubdivisions * 2) * 3;
-	unsigned int* indices = (unsigned int*)Allocator.Allocate(sizeof(unsigned int) * indexCount);
-
-	unsigned int iIndex = 0;
-	const int iFirstLine = 0;
-	for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-		indices[iIndex++] = vertexCount - 2;
-		indices[iIndex++] = iFirstLine + j;
-		indices[iIndex++] = iFirstLine + ((j + 1) % horizontalSubdivisions);
+	// unit sphere centered on the origin, with white vertex colors
+	void createSphereBuffer3D(Buffer3D& buffer, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions) {
+		const unsigned int vertexCount = sphereVertexCount(horizontalSubdivisions, verticalSubdivisions);
+		const unsigned int indexCount = sphereIndexCount(horizontalSubdivisions, verticalSubdivisions);
+
+		glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
+		glm::vec3* normals = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
+		glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
+		unsigned int* indices = (unsigned int*)Allocator.Allocate(sizeof(unsigned int) * indexCount);
+
+		tessellateSphere(glm::vec3(0.f), 1.f, horizontalSubdivisions, verticalSubdivisions, glm::vec4(1.f), vertices, normals, colors, indices);
+
+		CreateBuffer3DParams createSphereBufferParams;
+		createSphereBufferParams.pVertices = vertices;
+		createSphereBufferParams.pNormals = normals;
+		createSphereBufferParams.pColors = colors;
+		createSphereBufferParams.pIndices = indices;
+		createSphereBufferParams.vertexCount = vertexCount;
+		createSphereBufferParams.indexCount = indexCount;
+		createBuffer3D(buffer, createSphereBufferParams);
+
+		Allocator.Free(indices);
+		Allocator.Free(colors);
+		Allocator.Free(normals);
+		Allocator.Free(vertices);
 	}
+}
 
-	for (unsigned int i = 0; i < verticalSubdivisions - 2; ++i) {
-		for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-			const unsigned int iA = (i * horizontalSubdivisions) + j;
-			const unsigned int iB = (i * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
-			const unsigned int iC = ((i + 1) * horizontalSubdivisions) + j;
-			const unsigned int iD = ((i + 1) * horizontalSubdivisions) + ((j + 1) % horizontalSubdivisions);
-			indices[iIndex++] = iA;
-			indices[iIndex++] = iC;
-			indices[iIndex++] = iD;
-			indices[iIndex++] = iA;
-			indices[iIndex++] = iD;
-			indices[iIndex++] = iB;
-		}
+void RenderApi3D::solidSphere(const glm::vec3& center, float radius, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions, const glm::vec4& color) const {
+	
+	horizontalSubdivisions = glm::max(horizontalSubdivisions, 4u);
+	verticalSubdivisions = glm::max(verticalSubdivisions, 2u);
+
+	const MeshCache::Key key = { MeshCache::ePrimitive::Sphere, { horizontalSubdivisions, verticalSubdivisions } };
+	const Buffer3D& mesh = cachedMesh(pRenderEngine->meshCache, key, [&](Buffer3D& buffer) {
+		createSphereBuffer3D(buffer, horizontalSubdivisions, verticalSubdivisions);
+	});
+
+	glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), center);
+	model = glm::scale(model, glm::vec3(radius));
+	drawCachedMesh(*this, mesh, color, model);
+}
+
+void RenderApi3D::instancedSpheres(glm::vec3 const* positions, float const* radii, glm::vec4 const* colors, unsigned int count) const {
+	if (count == 0) {
+		return;
 	}
 
-	const int iLastLine = (verticalSubdivisions - 2) * horizontalSubdivisions;
-	for (unsigned int j = 0; j < horizontalSubdivisions; ++j) {
-		indices[iIndex++] = vertexCount - 1;
-		indices[iIndex++] = iLastLine + j;
-		indices[iIndex++] = iLastLine + ((j + 1) % horizontalSubdivisions);
+	RenderEngine& engine = *pRenderEngine;
+
+	// the unit sphere is tessellated and uploaded on first use only
+	if (engine.instancedSphere.vao == 0) {
+		createSphereBuffer3D(engine.instancedSphere, 16, 12);
+		addInstanceAttribs3D(engine.instancedSphere);
 	}
 
-	Buffer3D buffer3D;
+	const GLsizeiptr colorsOffset = alignStreamOffset(count * sizeof(glm::vec4));
+	const StreamAllocation allocation = allocateStreamBuffer(engine.streamBuffer, colorsOffset + count * sizeof(glm::vec4));
+	glm::vec4* centerRadius = (glm::vec4*)allocation.pData;
+	for (unsigned int i = 0; i < count; ++i) {
+		centerRadius[i] = glm::vec4(positions[i], radii[i]);
+	}
+	memcpy(allocation.pData + colorsOffset, colors, count * sizeof(glm::vec4));
+	commitStreamAllocation(engine.streamBuffer, allocation);
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = normals;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.pIndices = indices;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createCubeBufferParams.indexCount = indexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+	const GLuint vao = engine.instancedSphere.vao;
+	glVertexArrayVertexBuffer(vao, InstanceAttribCenterRadius, allocation.buffer, allocation.offset, sizeof(glm::vec4));
+	glVertexArrayVertexBuffer(vao, InstanceAttribColor, allocation.buffer, allocation.offset + colorsOffset, sizeof(glm::vec4));
 
-	buffer(buffer3D, eDrawMode::Triangles, nullptr);
+	const ShaderProgram3D& shader = engine.shader3D_instanced;
+	glUseProgram(shader.programId);
+	glProgramUniformMatrix4fv(shader.programId, shader.modelLocation, 1, 0, glm::value_ptr(glm::identity<glm::mat4>()));
+	glProgramUniform1i(shader.programId, shader.lightingEnabledLocation, 1);
 
-	deleteBuffer3D(buffer3D);
+	glBindVertexArray(engine.instancedSphere.vao);
+	glDrawElementsInstanced(GL_TRIANGLES, engine.instancedSphere.indexCount, GL_UNSIGNED_INT, nullptr, count);
+	glBindVertexArray(0);
 
-	Allocator.Free(indices);
-	Allocator.Free(colors);
-	Allocator.Free(normals);
-	Allocator.Free(vertices);
+	glUseProgram(pShader3D->programId);
 }
 
 void RenderApi3D::bone(const glm::vec3& childRelativePosition, const glm::vec4& color, const glm::quat& parentAbsoluteRotation, const glm::vec3& parentAbsolutePosition) const {
@@ -386,80 +591,112 @@ void RenderApi3D::bone(const glm::vec3& childRelativePosition, const glm::vec4&
 		normals[i + 2] = normal;
 	}
 
-	glm::vec4 colors[vertexCount];
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
-	}
-
-	Buffer3D buffer3D;
+	ImmediateBatch3D::Stream& stream = pRenderEngine->immediateBatch3D.streams[ImmediateBatch3D::StreamTriangles];
+	appendImmediate(stream, vertices, normals, vertexCount, color, nullptr);
+}
 
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = normals;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
+void RenderApi3D::horizontalPlane(const glm::vec3& center, const glm::vec2& size, unsigned int SideSubdivision, const glm::vec4& color) const {
+	SideSubdivision = glm::max(SideSubdivision, 1u);
+
+	const MeshCache::Key key = { MeshCache::ePrimitive::Plane, { SideSubdivision, 0 } };
+	const Buffer3D& mesh = cachedMesh(pRenderEngine->meshCache, key, [&](Buffer3D& buffer) {
+		unsigned int NbVertexBySide = SideSubdivision + 1;
+		unsigned int vertexCount = NbVertexBySide * NbVertexBySide;
+
+		glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
+		glm::vec3* normals = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
+		glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
+
+		unsigned int indiceCount = SideSubdivision * SideSubdivision * 6;
+		unsigned int* indices = (unsigned int*)Allocator.Allocate(sizeof(unsigned int) * indiceCount);
+
+		// unit plane centered on the origin
+		float fStep = 1.f / SideSubdivision;
+		const glm::vec3 Start = glm::vec3(-0.5f, 0.f, -0.5f);
+		for (unsigned int iVertexX = 0; iVertexX < NbVertexBySide; ++iVertexX) {
+			for (unsigned int iVertexZ = 0; iVertexZ < NbVertexBySide; ++iVertexZ) {
+				unsigned int Indice = iVertexX * NbVertexBySide + iVertexZ;
+				vertices[Indice] = { Start.x + iVertexX * fStep, Start.y, Start.z + iVertexZ * fStep };
+				normals[Indice] = { 0.f, 1.f, 0.f };
+				colors[Indice] = glm::vec4(1.f);
+			}
+		}
 
-	buffer(buffer3D, eDrawMode::Triangles, nullptr);
+		for (unsigned int iSquareX = 0; iSquareX < SideSubdivision; ++iSquareX) {
+			for (unsigned int iSquareY = 0; iSquareY < SideSubdivision; ++iSquareY) {
+				unsigned int iVertexStart = iSquareX * NbVertexBySide + iSquareY;
+				unsigned int iIndiceStart = (iSquareX * SideSubdivision + iSquareY) * 6;
+				indices[iIndiceStart + 0] = iVertexStart;
+				indices[iIndiceStart + 1] = iVertexStart + 1;
+				indices[iIndiceStart + 2] = iVertexStart + NbVertexBySide + 1;
+				indices[iIndiceStart + 3] = iVertexStart;
+				indices[iIndiceStart + 4] = iVertexStart + NbVertexBySide + 1;
+				indices[iIndiceStart + 5] = iVertexStart + NbVertexBySide;
+			}
+		}
 
-	deleteBuffer3D(buffer3D);
+		CreateBuffer3DParams createPlaneBufferParams;
+		createPlaneBufferParams.pVertices = vertices;
+		createPlaneBufferParams.pNormals = normals;
+		createPlaneBufferParams.pColors = colors;
+		createPlaneBufferParams.pIndices = indices;
+		createPlaneBufferParams.vertexCount = vertexCount;
+		createPlaneBufferParams.indexCount = indiceCount;
+		createBuffer3D(buffer, createPlaneBufferParams);
+
+		Allocator.Free(indices);
+		Allocator.Free(colors);
+		Allocator.Free(normals);
+		Allocator.Free(vertices);
+	});
+
+	glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), center);
+	model = glm::scale(model, glm::vec3(size.x, 1.f, size.y));
+	drawCachedMesh(*this, mesh, color, model);
 }
 
-void RenderApi3D::horizontalPlane(const glm::vec3& center, const glm::vec2& size, unsigned int SideSubdivision, const glm::vec4& color) const {
-	unsigned int NbVertexBySide = SideSubdivision + 1;
-	unsigned int vertexCount = NbVertexBySide * NbVertexBySide;
+namespace {
+	// One draw worth of 2d geometry, written by the caller straight into the streaming buffer
+	struct StreamedGeometry2D {
+		StreamAllocation allocation;
+		glm::vec2* pVertices = nullptr;
+		glm::vec4* pColors = nullptr;
+		GLintptr colorsOffset = 0;
+		GLsizei vertexCount = 0;
+	};
 
-	glm::vec3* vertices = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec3* normals = (glm::vec3*)Allocator.Allocate(sizeof(glm::vec3) * vertexCount);
-	glm::vec4* colors = (glm::vec4*)Allocator.Allocate(sizeof(glm::vec4) * vertexCount);
-
-	unsigned int indiceCount = SideSubdivision * SideSubdivision * 6;
-	unsigned int* indices = (unsigned int*)Allocator.Allocate(sizeof(unsigned int) * indiceCount);
-
-	float fStepX = size.x / SideSubdivision;
-	float fStepZ = size.y / SideSubdivision;
-	glm::vec3& Start = glm::vec3(center.x - size.x * 0.5f, center.y, center.z - size.y * 0.5f);
-	for (unsigned int iVertexX = 0; iVertexX < NbVertexBySide; ++iVertexX) {
-		for (unsigned int iVertexZ = 0; iVertexZ < NbVertexBySide; ++iVertexZ) {
-			unsigned int Indice = iVertexX * NbVertexBySide + iVertexZ;
-			vertices[Indice] = { Start.x + iVertexX * fStepX, Start.y, Start.z + iVertexZ * fStepZ };
-			normals[Indice] = { 0.f, 1.f, 0.f };
-			colors[Indice] = color;
-		}
-	}
+	StreamedGeometry2D allocateStreamedGeometry2D(RenderEngine& engine, GLsizei vertexCount) {
+		StreamedGeometry2D geometry;
+		geometry.vertexCount = vertexCount;
+		geometry.colorsOffset = alignStreamOffset(vertexCount * sizeof(glm::vec2));
 
-	for (unsigned int iSquareX = 0; iSquareX < SideSubdivision; ++iSquareX) {
-		for (unsigned int iSquareY = 0; iSquareY < SideSubdivision; ++iSquareY) {
-			unsigned int iVertexStart = iSquareX * NbVertexBySide + iSquareY;
-			unsigned int iIndiceStart = (iSquareX * SideSubdivision + iSquareY) * 6;
-			indices[iIndiceStart + 0] = iVertexStart;
-			indices[iIndiceStart + 1] = iVertexStart + 1;
-			indices[iIndiceStart + 2] = iVertexStart + NbVertexBySide + 1;
-			indices[iIndiceStart + 3] = iVertexStart;
-			indices[iIndiceStart + 4] = iVertexStart + NbVertexBySide + 1;
-			indices[iIndiceStart + 5] = iVertexStart + NbVertexBySide;
-		}
+		geometry.allocation = allocateStreamBuffer(engine.streamBuffer, geometry.colorsOffset + vertexCount * sizeof(glm::vec4));
+		geometry.pVertices = (glm::vec2*)geometry.allocation.pData;
+		geometry.pColors = (glm::vec4*)(geometry.allocation.pData + geometry.colorsOffset);
+		return geometry;
 	}
 
+	void drawStreamedGeometry2D(const RenderApi2D& api, const StreamedGeometry2D& geometry, eDrawMode drawMode) {
+		RenderEngine& engine = *api.pRenderEngine;
+		commitStreamAllocation(engine.streamBuffer, geometry.allocation);
 
-	Buffer3D buffer3D;
-	CreateBuffer3DParams createCubeBufferParams;
-	createCubeBufferParams.pVertices = vertices;
-	createCubeBufferParams.pNormals = normals;
-	createCubeBufferParams.pColors = colors;
-	createCubeBufferParams.pIndices = indices;
-	createCubeBufferParams.vertexCount = vertexCount;
-	createCubeBufferParams.indexCount = indiceCount;
-	createBuffer3D(buffer3D, createCubeBufferParams);
-	buffer(buffer3D, eDrawMode::Triangles, nullptr);
-
-	deleteBuffer3D(buffer3D);
-	Allocator.Free(indices);
-	Allocator.Free(colors);
-	Allocator.Free(normals);
-	Allocator.Free(vertices);
+		const GLuint vao = engine.streamVao2D;
+		const GLuint streamBuffer = geometry.allocation.buffer;
+		const GLintptr offset = geometry.allocation.offset;
+		glVertexArrayVertexBuffer(vao, Buffer2D::BufferAttribVertex, streamBuffer, offset, sizeof(glm::vec2));
+		glVertexArrayVertexBuffer(vao, Buffer2D::BufferAttribColor, streamBuffer, offset + geometry.colorsOffset, sizeof(glm::vec4));
 
+		glBindVertexArray(vao);
+		glDrawArrays((GLenum)drawMode, 0, geometry.vertexCount);
+		glBindVertexArray(0);
+	}
 
+	// vertices must already be written, fills every color with color
+	void fillStreamedColors2D(const StreamedGeometry2D& geometry, const glm::vec4& color) {
+		for (GLsizei i = 0; i < geometry.vertexCount; ++i) {
+			geometry.pColors[i] = color;
+		}
+	}
 }
 
 void RenderApi2D::buffer(const Buffer2D& buffer, eDrawMode drawMode) const {
@@ -470,24 +707,11 @@ void RenderApi2D::buffer(const Buffer2D& buffer, eDrawMode drawMode) const {
 }
 
 void RenderApi2D::lines(glm::vec2 const* vertices, unsigned int vertexCount, const glm::vec4& color) const {
-	glm::vec4* colors = new glm::vec4[vertexCount];
-	for (unsigned int i = 0; i < vertexCount; ++i) {
-		colors[i] = color;
-	}
-
-	Buffer2D buffer2D;
-
-	CreateBuffer2DParams createBufferParams;
-	createBufferParams.pColors = colors;
-	createBufferParams.pVertices = vertices;
-	createBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createBufferParams);
-
-	buffer(buffer2D, eDrawMode::Lines);
+	StreamedGeometry2D geometry = allocateStreamedGeometry2D(*pRenderEngine, vertexCount);
+	memcpy(geometry.pVertices, vertices, vertexCount * sizeof(glm::vec2));
+	fillStreamedColors2D(geometry, color);
 
-	deleteBuffer2D(buffer2D);
-
-	delete[] colors;
+	drawStreamedGeometry2D(*this, geometry, eDrawMode::Lines);
 }
 
 void RenderApi2D::quadFill(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) const {
@@ -501,22 +725,11 @@ void RenderApi2D::quadFill(const glm::vec2& min, const glm::vec2& max, const glm
 	};
 	constexpr unsigned int vertexCount = COUNTOF(vertices);
 
-	glm::vec4 colors[vertexCount];
-	for (unsigned int iColor = 0; iColor < vertexCount; ++iColor) {
-		colors[iColor] = color;
-	}
-
-	Buffer2D buffer2D;
-
-	CreateBuffer2DParams createSquareBufferParams;
-	createSquareBufferParams.pColors = colors;
-	createSquareBufferParams.pVertices = vertices;
-	createSquareBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createSquareBufferParams);
-
-	buffer(buffer2D, eDrawMode::Triangles);
+	StreamedGeometry2D geometry = allocateStreamedGeometry2D(*pRenderEngine, vertexCount);
+	memcpy(geometry.pVertices, vertices, sizeof(vertices));
+	fillStreamedColors2D(geometry, color);
 
-	deleteBuffer2D(buffer2D);
+	drawStreamedGeometry2D(*this, geometry, eDrawMode::Triangles);
 }
 
 void RenderApi2D::quadContour(const glm::vec2& min, const glm::vec2& max, const glm::vec4& color) const {
@@ -540,8 +753,8 @@ void RenderApi2D::circleFill(const glm::vec2& center, float radius, unsigned int
 
 	const unsigned int vertexCount = subdivisions * 3;
 
-	glm::vec2* vertices = new glm::vec2[vertexCount];
-	glm::vec4* colors = new glm::vec4[vertexCount];
+	StreamedGeometry2D geometry = allocateStreamedGeometry2D(*pRenderEngine, vertexCount);
+	glm::vec2* vertices = geometry.pVertices;
 
 	int iVertex = 0;
 	glm::vec2 prev = { center.x + radius, center.y };
@@ -556,24 +769,9 @@ void RenderApi2D::circleFill(const glm::vec2& center, float radius, unsigned int
 		prev = current;
 	}
 
-	for (unsigned int iColor = 0; iColor < vertexCount; ++iColor) {
-		colors[iColor] = color;
-	}
-
-	Buffer2D buffer2D;
-
-	CreateBuffer2DParams createSquareBufferParams;
-	createSquareBufferParams.pColors = colors;
-	createSquareBufferParams.pVertices = vertices;
-	createSquareBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createSquareBufferParams);
-
-	buffer(buffer2D, eDrawMode::Triangles);
+	fillStreamedColors2D(geometry, color);
 
-	deleteBuffer2D(buffer2D);
-
-	delete[] vertices;
-	delete[] colors;
+	drawStreamedGeometry2D(*this, geometry, eDrawMode::Triangles);
 }
 
 void RenderApi2D::circleContour(const glm::vec2& center, float radius, unsigned int subdivisions, const glm::vec4& color) const {
@@ -581,8 +779,9 @@ void RenderApi2D::circleContour(const glm::vec2& center, float radius, unsigned
 
 	const unsigned int vertexCount = subdivisions * 2;
 
-	glm::vec2* vertices = new glm::vec2[vertexCount];
-	
+	StreamedGeometry2D geometry = allocateStreamedGeometry2D(*pRenderEngine, vertexCount);
+	glm::vec2* vertices = geometry.pVertices;
+
 	int iVertex = 0;
 	glm::vec2 prev = { center.x + radius, center.y };
 	for (unsigned int i = 1; i <= subdivisions; ++i) {
@@ -595,9 +794,9 @@ void RenderApi2D::circleContour(const glm::vec2& center, float radius, unsigned
 		prev = current;
 	}
 
-	lines(vertices, vertexCount, color);
+	fillStreamedColors2D(geometry, color);
 
-	delete[] vertices;
+	drawStreamedGeometry2D(*this, geometry, eDrawMode::Lines);
 }
 
 void RenderApi2D::arrow(const glm::vec2& from, const glm::vec2& to, float thickness, float hatRatio /*between 0 and 1*/, const glm::vec4& color) const {
@@ -624,20 +823,9 @@ void RenderApi2D::arrow(const glm::vec2& from, const glm::vec2& to, float thickn
 
 	constexpr unsigned int vertexCount = COUNTOF(vertices);
 
-	glm::vec4 colors[vertexCount];
-	for (unsigned int iColor = 0; iColor < vertexCount; ++iColor) {
-		colors[iColor] = color;
-	}
-
-	Buffer2D buffer2D;
-
-	CreateBuffer2DParams createSquareBufferParams;
-	createSquareBufferParams.pColors = colors;
-	createSquareBufferParams.pVertices = vertices;
-	createSquareBufferParams.vertexCount = vertexCount;
-	createBuffer2D(buffer2D, createSquareBufferParams);
-
-	buffer(buffer2D, eDrawMode::Triangles);
+	StreamedGeometry2D geometry = allocateStreamedGeometry2D(*pRenderEngine, vertexCount);
+	memcpy(geometry.pVertices, vertices, sizeof(vertices));
+	fillStreamedColors2D(geometry, color);
 
-	deleteBuffer2D(buffer2D);
+	drawStreamedGeometry2D(*this, geometry, eDrawMode::Triangles);
 }
\ No newline at end of file
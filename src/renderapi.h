@@ -5,6 +5,7 @@
 
 struct Buffer3D;
 struct Buffer2D;
+struct IndexBuffer3D;
 struct RenderEngine;
 struct ShaderProgram3D;
 
@@ -15,11 +16,15 @@ enum class eDrawMode : GLenum {
 };
 
 struct RenderApi3D {
-	RenderEngine const* pRenderEngine;
+	RenderEngine* pRenderEngine;
 	ShaderProgram3D const* pShader3D;
 
 	void buffer(const Buffer3D& buffer, eDrawMode drawMode, glm::mat4 const* pModel) const;
 
+	// lines, grid, axisXYZ and bone are batched per draw mode and only drawn by flush,
+	// which is called at the end of render3D and render3D_custom
+	void flush() const;
+
 	// warning: if you want to draw A-B-C-D, then vertices should contain A-B-B-C-C-D 
 	void lines(glm::vec3 const* vertices, unsigned int vertexCount, const glm::vec4& color, glm::mat4 const* pModel) const;
 
@@ -27,17 +32,27 @@ struct RenderApi3D {
 
 	void axisXYZ(glm::mat4 const* pModel) const;
 
+	// solidCube, solidSphere and horizontalPlane draw unit meshes tessellated once and kept in the
+	// mesh cache of the render engine, scaled and moved by the model matrix
 	void solidCube(float size, const glm::vec4& color, glm::mat4 const* pModel) const;
 
 	void solidSphere(const glm::vec3& center, float radius, unsigned int horizontalSubdivisions, unsigned int verticalSubdivisions, const glm::vec4& color) const;
 
+	// Draws count lit spheres in a single draw call, a cached unit sphere is scaled and moved by the per instance data.
+	// Always rendered with the default 3d shader, even from render3D_custom.
+	void instancedSpheres(glm::vec3 const* positions, float const* radii, glm::vec4 const* colors, unsigned int count) const;
+
+	// Draws the primitives of indexBuffer over vertexCount vertices written to the streaming buffer this frame,
+	// for meshes whose topology is fixed but whose vertices move every frame. Lit if normals is not null.
+	void streamedMesh(glm::vec3 const* positions, glm::vec3 const* normals, unsigned int vertexCount, const IndexBuffer3D& indexBuffer, eDrawMode drawMode, const glm::vec4& color) const;
+
 	void bone(const glm::vec3& childRelativePosition, const glm::vec4& color, const glm::quat& parentAbsoluteRotation, const glm::vec3& parentAbsolutePosition) const;
 	
 	void horizontalPlane(const glm::vec3& center, const glm::vec2& size, unsigned int SideSubdivision, const glm::vec4& color) const;
 };
 
 struct RenderApi2D {
-	RenderEngine const* pRenderEngine;
+	RenderEngine* pRenderEngine;
 
 	void buffer(const Buffer2D& buffer, eDrawMode drawMode) const;
 
@@ -7,32 +7,104 @@
 #include <glm/gtc/type_ptr.hpp>
 
 
-bool createRenderEngine(RenderEngine& engine) {
-	if (!createShaderProgram3D(engine.shader3D)) {
-		return false;
+namespace {
+	constexpr GLsizeiptr StreamBufferRegionSize = 16 * 1024 * 1024;
+
+	bool createShaders(RenderEngine& engine) {
+		if (!createShaderProgram3D(engine.shader3D)) {
+			return false;
+		}
+		if (!createShaderProgram3D_custom(engine.shader3D_custom)) {
+			return false;
+		}
+		if (!createShaderProgram3D_instanced(engine.shader3D_instanced)) {
+			return false;
+		}
+		if (!createShaderProgram2D(engine.shader2D)) {
+			return false;
+		}
+		return true;
 	}
-	if (!createShaderProgram3D_custom(engine.shader3D_custom)) {
+
+	// one binding per attribute, so each stream can be bound at its own offset
+	void addStreamAttrib(GLuint vao, GLuint location, GLint size) {
+		glEnableVertexArrayAttrib(vao, location);
+		glVertexArrayAttribFormat(vao, location, size, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(vao, location, location);
+	}
+}
+
+bool createRenderEngine(RenderEngine& engine) {
+	if (!createShaders(engine)) {
 		return false;
 	}
-	if (!createShaderProgram2D(engine.shader2D)) {
+
+	if (!createStreamBuffer(engine.streamBuffer, StreamBufferRegionSize)) {
 		return false;
 	}
+
+	glCreateVertexArrays(1, &engine.streamVao3D);
+	addStreamAttrib(engine.streamVao3D, Buffer3D::BufferAttribVertex, 3);
+	addStreamAttrib(engine.streamVao3D, Buffer3D::BufferAttribNormal, 3);
+	addStreamAttrib(engine.streamVao3D, Buffer3D::BufferAttribColor, 4);
+
+	glCreateVertexArrays(1, &engine.streamVao2D);
+	addStreamAttrib(engine.streamVao2D, Buffer2D::BufferAttribVertex, 2);
+	addStreamAttrib(engine.streamVao2D, Buffer2D::BufferAttribColor, 4);
+
 	return true;
 }
 
+void destroyRenderEngine(RenderEngine& engine) {
+	deleteStreamBuffer(engine.streamBuffer);
+	glDeleteVertexArrays(1, &engine.streamVao3D);
+	glDeleteVertexArrays(1, &engine.streamVao2D);
+	engine.streamVao3D = 0;
+	engine.streamVao2D = 0;
+	if (engine.instancedSphere.vao) {
+		deleteBuffer3D(engine.instancedSphere);
+	}
+	deleteMeshCache(engine.meshCache);
+}
+
+void evictUnusedMeshes(MeshCache& cache) {
+	for (size_t i = 0; i < cache.entries.size(); ) {
+		MeshCache::Entry& entry = cache.entries[i];
+		if (cache.frame - entry.lastUsedFrame > MeshCache::MaxUnusedFrames) {
+			deleteBuffer3D(entry.buffer);
+			entry = cache.entries.back();
+			cache.entries.pop_back();
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+void deleteMeshCache(MeshCache& cache) {
+	for (MeshCache::Entry& entry : cache.entries) {
+		deleteBuffer3D(entry.buffer);
+	}
+	cache.entries.clear();
+}
+
 bool reloadRenderEngineShaders(RenderEngine& engine) {
 	glDeleteProgram(engine.shader3D.programId);
 	glDeleteProgram(engine.shader3D_custom.programId);
+	glDeleteProgram(engine.shader3D_instanced.programId);
 	glDeleteProgram(engine.shader2D.programId);
-	return createRenderEngine(engine);
+	return createShaders(engine);
 }
 
-void renderEngineFrame(const RenderEngine& engine, const RenderParams& params) {
+void renderEngineFrame(RenderEngine& engine, const RenderParams& params) {
 	if(!params.viewportWidth || !params.viewportHeight) {
 		return;
 	}
 	glViewport(0, 0, params.viewportWidth, params.viewportHeight);
 
+	beginStreamBufferFrame(engine.streamBuffer);
+	engine.meshCache.frame++;
+
 	// Clear the front buffer
 	glClearColor(params.backgroundColor.r, params.backgroundColor.g, params.backgroundColor.b, params.backgroundColor.a);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -87,10 +159,20 @@ void renderEngineFrame(const RenderEngine& engine, const RenderParams& params) {
 		glProgramUniform1f(shader3D.programId, shader3D.specularLocation, params.specular);
 		glProgramUniform1f(shader3D.programId, shader3D.specularPowLocation, params.specularPow);
 
+		const ShaderProgram3D& shader3D_instanced = engine.shader3D_instanced;
+		glProgramUniformMatrix4fv(shader3D_instanced.programId, shader3D_instanced.viewLocation, 1, 0, glm::value_ptr(view));
+		glProgramUniformMatrix4fv(shader3D_instanced.programId, shader3D_instanced.projectionLocation, 1, 0, glm::value_ptr(projection));
+		glProgramUniform3fv(shader3D_instanced.programId, shader3D_instanced.lightDirLocation, 1, glm::value_ptr(lightViewSpaceVec3));
+		glProgramUniform1f(shader3D_instanced.programId, shader3D_instanced.lightStrengthLocation, params.lightStrength);
+		glProgramUniform1f(shader3D_instanced.programId, shader3D_instanced.ambientLocation, params.lightAmbient);
+		glProgramUniform1f(shader3D_instanced.programId, shader3D_instanced.specularLocation, params.specular);
+		glProgramUniform1f(shader3D_instanced.programId, shader3D_instanced.specularPowLocation, params.specularPow);
+
 		RenderApi3D api3D;
 		api3D.pShader3D = &shader3D;
 		api3D.pRenderEngine = &engine;
 		params.render3DCallback(api3D, params.pRender3DCallbackUserData);
+		api3D.flush();
 
 		// 3D Custom vertex shader
 		const ShaderProgram3D_custom& shader3D_custom = engine.shader3D_custom;
@@ -114,6 +196,7 @@ void renderEngineFrame(const RenderEngine& engine, const RenderParams& params) {
 		}
 		api3D.pShader3D = &shader3D_custom;
 		params.render3DCustomCallback(api3D, params.pRender3DCustomCallbackUserData);
+		api3D.flush();
 		glDeleteBuffers(1, &ssbo);
 		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 	}
@@ -137,6 +220,18 @@ void renderEngineFrame(const RenderEngine& engine, const RenderParams& params) {
 		params.render2DCallback(api2D, params.pRender3DCallbackUserData);
 	}
 
+	endStreamBufferFrame(engine.streamBuffer);
+	evictUnusedMeshes(engine.meshCache);
+
+	const StreamBuffer::Stats& streamStats = engine.streamBuffer.lastFrameStats;
+	constexpr float megabyte = 1024.f * 1024.f;
+	engine.stats.streamFenceWaitMs = streamStats.fenceWaitMs;
+	engine.stats.streamUsedSize = streamStats.usedBytes / megabyte;
+	engine.stats.streamRegionSize = engine.streamBuffer.regionSize / megabyte;
+	engine.stats.streamOverflowSize = streamStats.overflowBytes / megabyte;
+	engine.stats.streamAllocationCount = streamStats.allocationCount;
+	engine.stats.cachedMeshCount = int(engine.meshCache.entries.size());
+
 	// restore gl state
 	if (bEnableBlend) {
 		glEnable(GL_BLEND);
@@ -3,11 +3,14 @@
 #include <glad.h>
 
 #include "shader.h"
+#include "drawbuffer.h"
 
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
+#include <vector>
+
 struct RenderApi3D;
 struct RenderApi2D;
 struct Camera;
@@ -15,13 +18,83 @@ struct RenderParams;
 struct Buffer3D;
 struct Buffer2D;
 
+// Lines and small meshes recorded by RenderApi3D during a 3d pass. They are appended to
+// one vertex stream per draw mode and drawn by RenderApi3D::flush at the end of the pass.
+struct ImmediateBatch3D {
+	enum {
+		StreamLines = 0, // unlit, no normals
+		StreamTriangles, // lit
+		StreamCount
+	};
+	struct Stream {
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec4> colors;
+	};
+	Stream streams[StreamCount];
+};
+
+// GPU resident meshes of the procedural primitives of RenderApi3D, tessellated once per set of
+// tessellation parameters. They are unit sized, placed by the model matrix and colored by the
+// UniformColor of the shader. Entries unused for MaxUnusedFrames frames are deleted.
+struct MeshCache {
+	static constexpr unsigned int MaxUnusedFrames = 300;
+
+	enum class ePrimitive {
+		Cube,
+		Sphere,
+		Plane,
+	};
+	struct Key {
+		ePrimitive primitive;
+		unsigned int subdivisions[2];
+	};
+	struct Entry {
+		Key key;
+		Buffer3D buffer;
+		unsigned int lastUsedFrame;
+	};
+	std::vector<Entry> entries;
+	unsigned int frame = 0;
+};
+
+void evictUnusedMeshes(MeshCache& cache);
+void deleteMeshCache(MeshCache& cache);
+
+// Filled by renderEngineFrame, sizes are in megabytes
+struct RenderStats {
+	float streamFenceWaitMs = 0.f;
+	float streamUsedSize = 0.f;
+	float streamRegionSize = 0.f;
+	float streamOverflowSize = 0.f;
+	int streamAllocationCount = 0;
+	int cachedMeshCount = 0;
+};
+
 struct RenderEngine {
 	ShaderProgram3D shader3D;
 	ShaderProgram3D_custom shader3D_custom;
+	ShaderProgram3D shader3D_instanced;
 	ShaderProgram2D shader2D;
+
+	// unit sphere uploaded once and drawn by RenderApi3D::instancedSpheres
+	Buffer3D instancedSphere;
+
+	ImmediateBatch3D immediateBatch3D;
+	MeshCache meshCache;
+
+	// every geometry generated by RenderApi3D and RenderApi2D is written in streamBuffer,
+	// the stream vaos only hold the vertex formats, buffers are bound per draw
+	StreamBuffer streamBuffer;
+	GLuint streamVao3D = 0;
+	GLuint streamVao2D = 0;
+
+	RenderStats stats;
 };
 
 bool createRenderEngine(RenderEngine& engine);
+// Releases the GPU resources of engine, the GL context must still be current
+void destroyRenderEngine(RenderEngine& engine);
 bool reloadRenderEngineShaders(RenderEngine& engine);
 
 
@@ -60,4 +133,4 @@ struct RenderParams {
 	unsigned int CustomVertShaderDataSize;
 };
 
-void renderEngineFrame(const RenderEngine& engine, const RenderParams& params);
\ No newline at end of file
+void renderEngineFrame(RenderEngine& engine, const RenderParams& params);
\ No newline at end of file
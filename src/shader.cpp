@@ -131,6 +131,8 @@ void	 ShaderProgram3D::LoadLocation() {
 	specularLocation = glGetUniformLocation(programId, "Specular");
 	specularPowLocation = glGetUniformLocation(programId, "SpecularPow");
 	lightingEnabledLocation = glGetUniformLocation(programId, "LightingEnabled");
+	useUniformColorLocation = glGetUniformLocation(programId, "UseUniformColor");
+	uniformColorLocation = glGetUniformLocation(programId, "UniformColor");
 }
 
 bool createShaderProgram3D(ShaderProgram3D& program) {
@@ -165,6 +167,19 @@ bool createShaderProgram3D_custom(ShaderProgram3D_custom& program) {
 	return true;
 }
 
+bool createShaderProgram3D_instanced(ShaderProgram3D& program) {
+	CreateShaderProgramParams params;
+	params.szVertFilePath = SHADER_PATH "shader_3d_instanced.vert";
+	params.szFragFilePath = SHADER_PATH "shader_3d.frag";
+	if (!createShaderProgram(program, params)) {
+		assert(false);
+		return false;
+	}
+	// Upload uniforms
+	program.LoadLocation();
+	return true;
+}
+
 bool createShaderProgram2D(ShaderProgram2D& program) {
 	CreateShaderProgramParams params;
 	params.szVertFilePath = SHADER_PATH "shader_2d.vert";
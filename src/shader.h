@@ -25,6 +25,8 @@ struct ShaderProgram3D : ShaderProgram {
 	GLuint specularLocation;
 	GLuint specularPowLocation;
 	GLuint lightingEnabledLocation;
+	GLuint useUniformColorLocation;
+	GLuint uniformColorLocation;
 
 	void	 LoadLocation();
 };
@@ -38,6 +40,9 @@ struct ShaderProgram3D_custom : ShaderProgram3D {
 
 bool createShaderProgram3D_custom(ShaderProgram3D_custom& program);
 
+// Reads the center, radius and color of each instance from per instance vertex attributes
+bool createShaderProgram3D_instanced(ShaderProgram3D& program);
+
 struct ShaderProgram2D : ShaderProgram {
 	GLuint viewportSizeLocation;
 };
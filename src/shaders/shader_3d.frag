@@ -22,6 +22,10 @@ void main()
 {
 	if(LightingEnabled) {
 		vec3 n = normalize(In.CameraSpaceNormal);
+		// two sided lighting, open surfaces like cloth show their back faces
+		if (!gl_FrontFacing) {
+			n = -n;
+		}
 		vec3 l = normalize(LightDir);
 		float ndotl =  max(dot(n, l), 0.0);
 		float lightContrib = ndotl * LightStrength;
@@ -8,6 +8,10 @@ uniform mat4 Model;
 uniform mat4 View;
 uniform mat4 Projection;
 
+// set for the cached meshes, whose vertex colors are white
+uniform bool UseUniformColor;
+uniform vec4 UniformColor;
+
 layout(location = BufferAttribVertex) in vec3 Position;
 layout(location = BufferAttribNormal) in vec3 Normal;
 layout(location = BufferAttribColor) in vec4 Color;
@@ -25,7 +29,7 @@ void main()
 	vec4 p = vec4(Position, 1.0);
 	vec4 n = vec4(Normal, 0.0);
 	gl_Position = Projection * MV * p;
-	Out.Color = Color;
+	Out.Color = UseUniformColor ? UniformColor : Color;
 	Out.CameraSpacePosition = vec3(MV * p);
 	Out.CameraSpaceNormal = vec3(MV * n);
 }
\ No newline at end of file
@@ -12,6 +12,8 @@ uniform mat4 Model; // Model matrix
 uniform mat4 View;  // View matrix
 uniform mat4 Projection; // Projection Matrix
 uniform float Time; // Elapsed time since the begining of the program
+uniform bool UseUniformColor; // true when the color of the drawcall is given by UniformColor instead of the vertices
+uniform vec4 UniformColor;
 
 //-- attributes can change for each vertex
 layout(location = BufferAttribVertex) in vec3 Position; // Position of current vertex
@@ -33,19 +35,20 @@ out block //define the additional output that will be received by the fragment s
 
 void main()
 {
-	mat4 MV = View * Model;
-	
-	float XParity = mod(3.*Position.x + Time, 2.0f);
+	// the displacement is computed in world space, so it does not depend on how the mesh is scaled by the model matrix
+	vec4 WorldPos = Model * vec4(Position, 1);
+
+	float XParity = mod(3.*WorldPos.x + Time, 2.0f);
 	XParity = step(XParity, 0.2f);
-	vec4 NewPos = vec4(Position, 1);
+	vec4 NewPos = WorldPos;
 	NewPos.x += Data.center.x;
 	NewPos.y += XParity * 0.25 + Data.center.y;
 	NewPos.z += Data.center.z;
 
-	Out.CameraSpacePosition = vec3(MV * NewPos);
-	Out.CameraSpaceNormal = vec3(MV * vec4(Normal, 0.0f));
-	Out.Color = Color;
+	Out.CameraSpacePosition = vec3(View * NewPos);
+	Out.CameraSpaceNormal = vec3(View * Model * vec4(Normal, 0.0f));
+	Out.Color = UseUniformColor ? UniformColor : Color;
 	Out.Color.r = (sin(Time) + 1.0f)*0.5f;
 	//gl_position is always an output and is the resulting vertex pos that will be feeded to fragment shader
-	gl_Position = Projection * MV * NewPos;
+	gl_Position = Projection * View * NewPos;
 }
\ No newline at end of file
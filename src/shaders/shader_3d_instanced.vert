@@ -0,0 +1,37 @@
+#version 410 core
+
+#define BufferAttribVertex 0
+#define BufferAttribNormal 1
+#define BufferAttribColor 2
+#define BufferAttribInstanceCenterRadius 3
+#define BufferAttribInstanceColor 4
+
+uniform mat4 Model;
+uniform mat4 View;
+uniform mat4 Projection;
+
+// unit mesh, shared by every instance
+layout(location = BufferAttribVertex) in vec3 Position;
+layout(location = BufferAttribNormal) in vec3 Normal;
+
+// per instance data
+layout(location = BufferAttribInstanceCenterRadius) in vec4 InstanceCenterRadius;
+layout(location = BufferAttribInstanceColor) in vec4 InstanceColor;
+
+out block
+{
+	vec4 Color;
+	vec3 CameraSpacePosition;
+	vec3 CameraSpaceNormal;
+} Out;
+
+void main()
+{
+	mat4 MV = View * Model;
+	vec4 p = vec4(InstanceCenterRadius.xyz + Position * InstanceCenterRadius.w, 1.0);
+	vec4 n = vec4(Normal, 0.0);
+	gl_Position = Projection * MV * p;
+	Out.Color = InstanceColor;
+	Out.CameraSpacePosition = vec3(MV * p);
+	Out.CameraSpaceNormal = vec3(MV * n);
+}
@@ -0,0 +1,118 @@
+#include "threadpool.h"
+
+#include <assert.h>
+
+namespace {
+	// Returns false once every range of the current job has been handed out
+	bool processNextRange(ThreadPool& pool, const ParallelRangeFunction& function) {
+		const size_t range = pool.nextRange.fetch_add(1);
+		if (range >= pool.rangeCount) {
+			return false;
+		}
+
+		const size_t begin = range * pool.grainSize;
+		const size_t end = begin + pool.grainSize < pool.itemCount ? begin + pool.grainSize : pool.itemCount;
+		function(begin, end);
+
+		if (pool.doneRangeCount.fetch_add(1) + 1 == pool.rangeCount) {
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			pool.doneCondition.notify_all();
+		}
+		return true;
+	}
+
+	void workerLoop(ThreadPool& pool) {
+		unsigned int seenGeneration = 0;
+		for (;;) {
+			ParallelRangeFunction const* pFunction = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(pool.mutex);
+				pool.wakeCondition.wait(lock, [&] { return pool.stopping || pool.jobGeneration != seenGeneration; });
+				if (pool.stopping) {
+					return;
+				}
+				seenGeneration = pool.jobGeneration;
+				if (!pool.pFunction) {
+					continue; // woke up after the job was already finished
+				}
+				pFunction = pool.pFunction;
+				pool.busyWorkerCount++;
+			}
+
+			while (processNextRange(pool, *pFunction)) {
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(pool.mutex);
+				pool.busyWorkerCount--;
+				pool.doneCondition.notify_all();
+			}
+		}
+	}
+}
+
+void createThreadPool(ThreadPool& pool, unsigned int workerCount) {
+	assert(pool.workers.empty()); // trying to create a pool already started
+	pool.stopping = false;
+	for (unsigned int i = 0; i < workerCount; ++i) {
+		pool.workers.emplace_back(workerLoop, std::ref(pool));
+	}
+}
+
+void deleteThreadPool(ThreadPool& pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.stopping = true;
+	}
+	pool.wakeCondition.notify_all();
+	for (std::thread& worker : pool.workers) {
+		worker.join();
+	}
+	pool.workers.clear();
+	pool.stopping = false;
+}
+
+void resizeThreadPool(ThreadPool& pool, unsigned int workerCount) {
+	if (pool.workers.size() == workerCount) {
+		return;
+	}
+	deleteThreadPool(pool);
+	createThreadPool(pool, workerCount);
+}
+
+unsigned int defaultThreadPoolWorkerCount() {
+	const unsigned int hardwareThreadCount = std::thread::hardware_concurrency();
+	return hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 0;
+}
+
+void parallelFor(ThreadPool& pool, size_t itemCount, size_t grainSize, const ParallelRangeFunction& function) {
+	if (itemCount == 0) {
+		return;
+	}
+	grainSize = grainSize > 0 ? grainSize : 1;
+
+	if (pool.workers.empty() || itemCount <= grainSize) {
+		function(0, itemCount);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		assert(!pool.pFunction); // parallelFor is not reentrant
+		pool.itemCount = itemCount;
+		pool.grainSize = grainSize;
+		pool.rangeCount = (itemCount + grainSize - 1) / grainSize;
+		pool.nextRange = 0;
+		pool.doneRangeCount = 0;
+		pool.pFunction = &function;
+		pool.jobGeneration++;
+	}
+	pool.wakeCondition.notify_all();
+
+	while (processNextRange(pool, function)) {
+	}
+
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.doneCondition.wait(lock, [&] { return pool.doneRangeCount == pool.rangeCount && pool.busyWorkerCount == 0; });
+	pool.pFunction = nullptr;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using ParallelRangeFunction = std::function<void(size_t begin, size_t end)>;
+
+// Fixed set of worker threads executing parallelFor jobs. The calling thread also
+// processes ranges, so a pool without workers runs the job inline.
+struct ThreadPool {
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+
+	// current job, only valid while pFunction is not null
+	ParallelRangeFunction const* pFunction = nullptr;
+	size_t itemCount = 0;
+	size_t grainSize = 1;
+	size_t rangeCount = 0;
+	std::atomic<size_t> nextRange{ 0 };
+	std::atomic<size_t> doneRangeCount{ 0 };
+	unsigned int busyWorkerCount = 0;
+	unsigned int jobGeneration = 0;
+	bool stopping = false;
+};
+
+// workerCount threads are started in addition to the calling thread
+void createThreadPool(ThreadPool& pool, unsigned int workerCount);
+
+void deleteThreadPool(ThreadPool& pool);
+
+// Stops the current workers and starts workerCount new ones
+void resizeThreadPool(ThreadPool& pool, unsigned int workerCount);
+
+// Number of workers to start to use every hardware thread, the calling thread included
+unsigned int defaultThreadPoolWorkerCount();
+
+// Splits [0, itemCount) into ranges of grainSize items and calls function once per range.
+// Ranges are processed concurrently in no particular order, returns once all of them are done.
+void parallelFor(ThreadPool& pool, size_t itemCount, size_t grainSize, const ParallelRangeFunction& function);
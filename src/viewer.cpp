@@ -351,6 +351,7 @@ int /*exit code*/ Viewer::run() {
 		renderParams.CustomVertShaderDataSize = CustomShaderDataSize;
 
 		renderEngineFrame(renderEngine, renderParams);
+		renderStats = renderEngine.stats;
 
 		// Start the Dear ImGui frame
 		ImGui_ImplOpenGL3_NewFrame();
@@ -381,6 +382,7 @@ int /*exit code*/ Viewer::run() {
 	}
 
 	// Cleanup
+	destroyRenderEngine(renderEngine);
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -389,4 +391,12 @@ int /*exit code*/ Viewer::run() {
 	glfwTerminate();
 
 	return 0;
-}
\ No newline at end of file
+}
+void Viewer::drawRenderStatsGUI() const {
+	ImGui::Text("Stream buffer: %.2f / %.2f MB per frame, %d allocations", renderStats.streamUsedSize, renderStats.streamRegionSize, renderStats.streamAllocationCount);
+	ImGui::Text("Stream fence wait: %.3f ms", renderStats.streamFenceWaitMs);
+	ImGui::Text("Cached meshes: %d", renderStats.cachedMeshCount);
+	if (renderStats.streamOverflowSize > 0.f) {
+		ImGui::TextColored(ImVec4(1.f, 0.4f, 0.4f, 1.f), "Stream overflow: %.2f MB, grow the ring", renderStats.streamOverflowSize);
+	}
+}
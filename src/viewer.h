@@ -1,6 +1,7 @@
 #pragma once
 
 #include "camera.h"
+#include "renderengine.h"
 #include <glm/vec4.hpp>
 
 struct RenderApi3D;
@@ -30,11 +31,16 @@ struct Viewer {
 	void* pCustomShaderData;
 	int CustomShaderDataSize;
 
+	RenderStats renderStats; // of the last rendered frame
+
 
 	Viewer(char const* initialWindowName, int initialViewportWidth, int initialViewportHeight);
 
 	int /*exit code*/ run();
 
+	// ImGui text showing renderStats, call it from drawGUI
+	void drawRenderStatsGUI() const;
+
 	// -----------------------------------
 	// override the following functions
 	// to create your own viewer